@@ -0,0 +1,136 @@
+#include <Modules/InventoryFilter.hpp>
+
+#include <fc/bitutil.hpp>
+#include <fc/io/json.hpp>
+
+#include <chrono>
+#include <iostream>
+
+// Replays synthetic inventory traffic through an InventoryFilter and measures how often it fails to rule out items the
+// node never saw, against the false positive rate it was sized for.
+//
+// For each block, the node sees the block and its transactions. Peers then advertise that block and its transactions,
+// which the node has, along with a competing block at the same height and as many transactions, which it doesn't.
+constexpr static auto USAGE =
+R"(Usage: InventoryFilterBenchmark [options]
+  --blocks <count>        Number of blocks to replay. Defaults to 20000.
+  --transactions <count>  Transactions per block. Defaults to 50.
+  --capacity <count>      Items per filter generation. Defaults to 1000000.
+  --rate <fraction>       False positive rate the filter is sized for. Defaults to 0.01.
+)";
+
+namespace {
+using Clock = std::chrono::steady_clock;
+namespace net = graphene::net;
+
+// A block ID as the chain makes them: a hash, with its first four bytes replaced by the big-endian block number
+graphene::protocol::block_id_type blockId(uint32_t num, uint32_t fork) {
+    auto id = fc::ripemd160::hash(std::to_string(num) + "/" + std::to_string(fork));
+    id._hash[0] = fc::endian_reverse_u32(num);
+    return id;
+}
+
+struct Tally {
+    uint64_t seenQueries = 0;
+    uint64_t unseenQueries = 0;
+    uint64_t falsePositives = 0;
+    // Seen items the filter wrongly ruled out; must be zero
+    uint64_t falseNegatives = 0;
+
+    void record(InventoryFilter::Answer answer, bool seen) {
+        bool maybe = answer != InventoryFilter::Answer::Unseen;
+        if (seen) {
+            ++seenQueries;
+            falseNegatives += !maybe;
+        } else {
+            ++unseenQueries;
+            falsePositives += maybe;
+        }
+    }
+    fc::mutable_variant_object report() const {
+        return fc::mutable_variant_object("seenQueries", seenQueries)
+                ("unseenQueries", unseenQueries)
+                ("falsePositives", falsePositives)
+                ("falseNegatives", falseNegatives)
+                ("falsePositiveRate", unseenQueries > 0? double(falsePositives) / unseenQueries : 0);
+    }
+};
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t blocks = 20000, transactions = 50;
+    size_t capacity = 1000000;
+    double rate = .01;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            FC_ASSERT(i + 1 < argc, "Missing value for ${A}", ("A", arg));
+            std::string value = argv[++i];
+            if (arg == "--blocks")
+                blocks = std::stoul(value);
+            else if (arg == "--transactions")
+                transactions = std::stoul(value);
+            else if (arg == "--capacity")
+                capacity = std::stoull(value);
+            else if (arg == "--rate")
+                rate = std::stod(value);
+            else
+                FC_THROW("Unknown option ${A}", ("A", arg));
+        }
+    } catch (const fc::exception& e) {
+        std::cerr << e.to_string() << "\n\n" << USAGE;
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    // Cover transactions from the start, rather than after an hour, so they're filtered too
+    InventoryFilter filter(0, capacity, rate, std::chrono::hours(24), std::chrono::seconds(0));
+    Tally blockTally, transactionTally;
+    Clock::duration checkTime{0};
+    uint64_t checks = 0, transactionNum = 0;
+
+    auto check = [&](const net::item_id& id, bool seen, Tally& tally) {
+        auto start = Clock::now();
+        auto answer = filter.check(id);
+        checkTime += Clock::now() - start;
+        ++checks;
+        if (answer == InventoryFilter::Answer::MaybeSeen)
+            filter.recordLookup(seen);
+        tally.record(answer, seen);
+    };
+
+    for (uint32_t num = 1; num <= blocks; ++num) {
+        std::vector<net::message_hash_type> seenTransactions;
+        for (uint32_t t = 0; t < transactions; ++t) {
+            seenTransactions.push_back(fc::ripemd160::hash("trx/" + std::to_string(transactionNum++)));
+            filter.transactionSeen(seenTransactions.back(), num - 1);
+        }
+        filter.blockSeen(blockId(num, 0), num - 1);
+
+        check(net::item_id(net::block_message_type, blockId(num, 0)), true, blockTally);
+        check(net::item_id(net::block_message_type, blockId(num, 1)), false, blockTally);
+        for (const auto& id : seenTransactions)
+            check(net::item_id(net::trx_message_type, id), true, transactionTally);
+        for (uint32_t t = 0; t < transactions; ++t)
+            check(net::item_id(net::trx_message_type,
+                                fc::ripemd160::hash("unseen/" + std::to_string(num) + "/" + std::to_string(t))),
+                  false, transactionTally);
+    }
+
+    const auto& counters = filter.getCounters();
+    fc::mutable_variant_object report;
+    report("blocks", blocks)
+          ("transactionsPerBlock", transactions)
+          ("itemsPerGeneration", capacity)
+          ("designFalsePositiveRate", rate)
+          ("blockIds", blockTally.report())
+          ("transactions", transactionTally.report())
+          ("filterFalsePositiveRate", counters.falsePositiveRate())
+          ("notCovered", counters.notCovered)
+          ("nanosecondsPerCheck", checks > 0? std::chrono::duration_cast<std::chrono::nanoseconds>(checkTime).count()
+                                              / int64_t(checks) : 0);
+    std::cout << fc::json::to_pretty_string(report) << std::endl;
+    return blockTally.falseNegatives + transactionTally.falseNegatives == 0? 0 : 1;
+}
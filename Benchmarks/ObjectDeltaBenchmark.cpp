@@ -0,0 +1,153 @@
+#include <Modules/ObjectDelta.hpp>
+
+#include <ContractApi.hpp>
+
+#include <graphene/db/object.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+
+// Measures the bytes and CPU time each modification of a contract object costs to describe to subscribers: as the full
+// variants of the object before and after, as changed fields found by comparing those variants, as a packed ObjectDelta,
+// and as changed fields found by comparing the object's reflected fields directly.
+//
+// Most modifications change a counter or two, as typical contract objects see; some append to a list or set a map
+// entry, so that the object's packed layout shifts.
+constexpr static auto USAGE =
+R"(Usage: ObjectDeltaBenchmark [options]
+  --modifications <count>  Number of modifications to measure. Defaults to 100000.
+  --history <count>        Initial length of the object's history list. Defaults to 100.
+  --seed <number>          Seed for choosing modifications. Defaults to 1.
+)";
+
+namespace {
+using Clock = std::chrono::steady_clock;
+namespace db = graphene::db;
+
+// A contract object of moderate size, with simple and structured fields
+struct BenchmarkObject : public db::abstract_object<BenchmarkObject> {
+    const static uint8_t space_id = 200;
+    const static uint8_t type_id = 1;
+
+    std::string name;
+    uint64_t balance = 0;
+    uint32_t updates = 0;
+    fc::time_point_sec lastUpdated;
+    std::vector<uint64_t> history;
+    std::map<std::string, std::string> attributes;
+};
+
+struct Measurement {
+    Clock::duration time{0};
+    uint64_t bytes = 0;
+
+    fc::mutable_variant_object report(uint64_t modifications) const {
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+        return fc::mutable_variant_object("bytesPerModification", modifications > 0? bytes / modifications : 0)
+                ("nanosecondsPerModification", modifications > 0? nanoseconds / int64_t(modifications) : 0);
+    }
+};
+
+size_t jsonSize(const fc::variant& v) { return fc::json::to_string(v).size(); }
+} // namespace
+
+FC_REFLECT_DERIVED(BenchmarkObject, (graphene::db::object),
+                   (name)(balance)(updates)(lastUpdated)(history)(attributes))
+
+int main(int argc, char** argv) {
+    uint64_t modifications = 100000;
+    uint32_t history = 100, seed = 1;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            FC_ASSERT(i + 1 < argc, "Missing value for ${A}", ("A", arg));
+            std::string value = argv[++i];
+            if (arg == "--modifications")
+                modifications = std::stoull(value);
+            else if (arg == "--history")
+                history = std::stoul(value);
+            else if (arg == "--seed")
+                seed = std::stoul(value);
+            else
+                FC_THROW("Unknown option ${A}", ("A", arg));
+        }
+    } catch (const fc::exception& e) {
+        std::cerr << e.to_string() << "\n\n" << USAGE;
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    BenchmarkObject object;
+    object.id = db::object_id_type(BenchmarkObject::space_id, BenchmarkObject::type_id, 1);
+    object.name = "benchmark-object";
+    object.lastUpdated = fc::time_point_sec(1600000000);
+    for (uint32_t i = 0; i < history; ++i)
+        object.history.push_back(i * 1000);
+    for (int i = 0; i < 10; ++i)
+        object.attributes["attribute" + std::to_string(i)] = "value" + std::to_string(i);
+
+    const auto reflection = reflectTable<BenchmarkObject>();
+    std::mt19937 random(seed);
+    Measurement fullVariants, variantChanges, packedDelta, reflectedChanges;
+    uint64_t changedFields = 0;
+
+    for (uint64_t m = 0; m < modifications; ++m) {
+        BenchmarkObject before = object;
+        auto choice = random() % 100;
+        object.balance += random() % 1000;
+        object.updates += 1;
+        if (choice < 5)
+            object.history.push_back(object.balance);
+        else if (choice < 10)
+            object.attributes["attribute" + std::to_string(random() % 20)] = std::to_string(object.balance);
+        else if (choice < 40)
+            object.lastUpdated += 3;
+
+        // The full variants of both states, as subscribers saw modifications before deltas
+        auto start = Clock::now();
+        auto beforeVariant = before.to_variant();
+        auto afterVariant = object.to_variant();
+        fullVariants.time += Clock::now() - start;
+        fullVariants.bytes += jsonSize(beforeVariant) + jsonSize(afterVariant);
+
+        // Changed fields, found by comparing those variants
+        start = Clock::now();
+        auto changes = ObjectDelta::fieldChanges(before.to_variant().get_object(), object.to_variant().get_object());
+        variantChanges.time += Clock::now() - start;
+        variantChanges.bytes += jsonSize(changes);
+
+        // The packed delta
+        start = Clock::now();
+        auto delta = ObjectDelta::compute(before.pack(), object.pack());
+        packedDelta.time += Clock::now() - start;
+        packedDelta.bytes += delta.has_value()? delta->packedSize() : 0;
+
+        // Changed fields, found by comparing the reflected fields
+        start = Clock::now();
+        auto reflected = ObjectDelta::fieldChanges(reflection, before, object, GRAPHENE_MAX_NESTED_OBJECTS);
+        reflectedChanges.time += Clock::now() - start;
+        reflectedChanges.bytes += jsonSize(reflected);
+
+        FC_ASSERT(reflected.size() == changes.size(), "Reflected and variant field changes disagree",
+                  ("Reflected", reflected)("Variant", changes));
+        changedFields += reflected.size();
+    }
+
+    fc::mutable_variant_object report;
+    report("modifications", modifications)
+          ("fields", reflection.fieldCount)
+          ("changedFieldsPerModification", modifications > 0? double(changedFields) / modifications : 0)
+          ("packedObjectBytes", object.pack().size())
+          ("fullVariants", fullVariants.report(modifications))
+          ("variantFieldChanges", variantChanges.report(modifications))
+          ("packedDelta", packedDelta.report(modifications))
+          ("reflectedFieldChanges", reflectedChanges.report(modifications));
+    std::cout << fc::json::to_pretty_string(report) << std::endl;
+    return 0;
+}
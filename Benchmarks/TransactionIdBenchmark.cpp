@@ -0,0 +1,139 @@
+#include <Modules/TransactionIdCache.hpp>
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/protocol/transfer.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+// Measures the per-block cost of computing the net::node message IDs of a block's transactions, the way handle_block
+// used to (building a trx_message for each transaction and taking its ID) against TransactionIdCache, on large
+// synthetic blocks.
+constexpr static auto USAGE =
+R"(Usage: TransactionIdBenchmark [options]
+  --blocks <count>        Number of blocks to measure. Defaults to 50.
+  --transactions <count>  Transactions per block. Defaults to 2000.
+  --operations <count>    Transfer operations per transaction. Defaults to 2.
+)";
+
+namespace {
+using Clock = std::chrono::steady_clock;
+namespace protocol = graphene::protocol;
+namespace net = graphene::net;
+
+protocol::signed_block makeBlock(uint32_t num, uint32_t transactions, uint32_t operations) {
+    protocol::signed_block block;
+    block.previous = fc::ripemd160::hash(std::to_string(num - 1));
+    block.timestamp = fc::time_point_sec(1600000000 + num * 3);
+    block.transactions.reserve(transactions);
+    for (uint32_t t = 0; t < transactions; ++t) {
+        protocol::signed_transaction trx;
+        trx.ref_block_num = num & 0xffff;
+        trx.ref_block_prefix = t;
+        trx.expiration = block.timestamp + 60;
+        for (uint32_t o = 0; o < operations; ++o) {
+            protocol::transfer_operation transfer;
+            transfer.fee = protocol::asset(20 + o);
+            transfer.from = protocol::account_id_type(num + t);
+            transfer.to = protocol::account_id_type(t + o + 1);
+            transfer.amount = protocol::asset(1000 * t + o);
+            trx.operations.emplace_back(std::move(transfer));
+        }
+        // The signatures are never checked, but they have to be there to be hashed
+        protocol::signature_type signature;
+        std::memset(&signature, int(t), sizeof(signature));
+        trx.signatures.push_back(signature);
+        block.transactions.emplace_back(std::move(trx));
+    }
+    return block;
+}
+
+int64_t microsecondsSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+fc::mutable_variant_object percentiles(std::vector<int64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double quantile) { return samples[std::min<size_t>(quantile * samples.size(),
+                                                                             samples.size() - 1)]; };
+    return fc::mutable_variant_object("p50", at(.5))("p90", at(.9))("max", samples.back());
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t blockCount = 50, transactions = 2000, operations = 2;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            FC_ASSERT(i + 1 < argc, "Missing value for ${A}", ("A", arg));
+            uint32_t value = std::stoul(argv[++i]);
+            if (arg == "--blocks")
+                blockCount = value;
+            else if (arg == "--transactions")
+                transactions = value;
+            else if (arg == "--operations")
+                operations = value;
+            else
+                FC_THROW("Unknown option ${A}", ("A", arg));
+        }
+        FC_ASSERT(blockCount > 0 && transactions > 0, "--blocks and --transactions must be positive");
+    } catch (const fc::exception& e) {
+        std::cerr << e.to_string() << "\n\n" << USAGE;
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    std::vector<int64_t> messageTimes, computeTimes, reuseTimes;
+    uint64_t blockBytes = 0;
+    // Enough room that no block is evicted before its second lookup
+    TransactionIdCache cache(blockCount);
+    for (uint32_t num = 1; num <= blockCount; ++num) {
+        auto block = makeBlock(num, transactions, operations);
+        blockBytes += fc::raw::pack_size(block);
+
+        // As handle_block used to: a whole message per transaction, only to take its ID
+        auto start = Clock::now();
+        std::vector<net::message_hash_type> expected;
+        expected.reserve(block.transactions.size());
+        for (const auto& trx : block.transactions)
+            expected.push_back(net::message(net::trx_message(trx)).id());
+        messageTimes.push_back(microsecondsSince(start));
+
+        start = Clock::now();
+        const auto& computed = cache.blockTransactionIds(block);
+        computeTimes.push_back(microsecondsSince(start));
+
+        start = Clock::now();
+        const auto& reused = cache.blockTransactionIds(block);
+        reuseTimes.push_back(microsecondsSince(start));
+
+        if (computed != expected || reused != expected) {
+            std::cerr << "Transaction IDs of block " << num << " differ from their message IDs" << std::endl;
+            return 1;
+        }
+    }
+
+    auto mean = [](const std::vector<int64_t>& samples) {
+        return double(std::accumulate(samples.begin(), samples.end(), int64_t(0))) / samples.size();
+    };
+    auto before = mean(messageTimes), after = mean(computeTimes);
+    fc::mutable_variant_object report;
+    report("blocks", blockCount)
+          ("transactionsPerBlock", transactions)
+          ("operationsPerTransaction", operations)
+          ("meanBlockBytes", blockBytes / blockCount)
+          ("messageIdMicroseconds", percentiles(messageTimes))
+          ("cacheComputeMicroseconds", percentiles(computeTimes))
+          ("cacheReuseMicroseconds", percentiles(reuseTimes))
+          ("speedup", after > 0? before / after : 0);
+    std::cout << fc::json::to_pretty_string(report) << std::endl;
+    return 0;
+}
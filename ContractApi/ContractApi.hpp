@@ -1,9 +1,18 @@
 #pragma once
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/evaluator.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/reflect/variant.hpp>
 
 #include <boost/config.hpp>
 
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 // REQUIRED:
 // This function is called to allow the contract to register itself with the blockchain.
 extern "C" BOOST_SYMBOL_EXPORT bool registerContract(graphene::chain::database&, uint8_t spaceId);
@@ -27,3 +36,169 @@ struct StringList {
 // A list of table names for the contract. If provided, it should contain a name for every table registered with the
 // chain, in the same order as the tables' type IDs with the chain.
 extern "C" BOOST_SYMBOL_EXPORT const StringList* tableNames;
+
+// A field of a table's objects which the node should index, so the table can be queried by that field efficiently.
+// The field is named as it appears in the objects' variant form; nested fields may be named with dots, like "a.b".
+struct IndexedField {
+    // Type ID of the table
+    const uint8_t typeId;
+    // Name of the field; expected to be null-terminated
+    const char* const field;
+};
+// A list of indexed fields with list length
+struct IndexedFieldList {
+    const IndexedField* const fields;
+    const uint32_t count;
+};
+
+// A list of the fields the node should index for queries. Fields not listed can only be queried by scanning the table.
+extern "C" BOOST_SYMBOL_EXPORT const IndexedFieldList* indexedFields;
+
+// The reflection of the object type of one of the contract's tables. With it, the node reads and compares individual
+// fields of the table's objects directly, rather than converting whole objects to variants. Generate these with
+// reflectTable.
+struct TableReflection {
+    // Type ID of the table
+    const uint8_t typeId;
+    // Number of the object type's reflected fields, including inherited ones, and their names in reflection order
+    const uint32_t fieldCount;
+    const char* const* const fieldNames;
+    // Get a field of an object in the table as a variant, by its index in fieldNames
+    fc::variant (*const getField)(const graphene::db::object& object, uint32_t field, uint32_t maxDepth);
+    // Check whether a field differs between two objects in the table, by its index in fieldNames
+    bool (*const fieldDiffers)(const graphene::db::object& a, const graphene::db::object& b, uint32_t field);
+};
+// A list of table reflections with list length
+struct TableReflectionList {
+    const TableReflection* const tables;
+    const uint32_t count;
+};
+
+// Reflections of the contract's tables. Tables without a reflection still work, but the node handles their objects
+// as whole variants where it needs their fields.
+extern "C" BOOST_SYMBOL_EXPORT const TableReflectionList* tableReflections;
+
+namespace ContractApiDetail {
+// Compare a field of two objects: simple values by value, and anything else by its packed form, which every reflected
+// type has, and which is equal exactly when the values serialize the same
+template<typename T>
+bool fieldsDiffer(const T& a, const T& b) {
+    if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_same_v<T, std::string>)
+        return a != b;
+    else
+        return fc::raw::pack(a) != fc::raw::pack(b);
+}
+
+// Accessors for each reflected field of Object, in reflection order
+template<typename Object>
+struct ReflectedFields {
+    std::vector<const char*> names;
+    std::vector<fc::variant (*)(const Object&, uint32_t)> getters;
+    std::vector<bool (*)(const Object&, const Object&)> comparers;
+
+    struct Collector {
+        ReflectedFields& fields;
+
+        template<typename Member, class Class, Member (Class::*member)>
+        void operator()(const char* name) const {
+            fields.names.push_back(name);
+            fields.getters.push_back([](const Object& o, uint32_t maxDepth) {
+                return fc::variant(o.*member, maxDepth);
+            });
+            fields.comparers.push_back([](const Object& a, const Object& b) {
+                return fieldsDiffer(a.*member, b.*member);
+            });
+        }
+    };
+
+    static const ReflectedFields& get() {
+        static const ReflectedFields fields = [] {
+            ReflectedFields fields;
+            fc::reflector<Object>::visit(Collector{fields});
+            return fields;
+        }();
+        return fields;
+    }
+};
+
+template<typename Object>
+fc::variant getField(const graphene::db::object& object, uint32_t field, uint32_t maxDepth) {
+    return ReflectedFields<Object>::get().getters.at(field)(static_cast<const Object&>(object), maxDepth);
+}
+template<typename Object>
+bool fieldDiffers(const graphene::db::object& a, const graphene::db::object& b, uint32_t field) {
+    return ReflectedFields<Object>::get().comparers.at(field)(static_cast<const Object&>(a),
+                                                             static_cast<const Object&>(b));
+}
+} // namespace ContractApiDetail
+
+// Generate the reflection of a table from its object type's FC reflection
+template<typename Object>
+TableReflection reflectTable() {
+    const auto& fields = ContractApiDetail::ReflectedFields<Object>::get();
+    return {Object::type_id, static_cast<uint32_t>(fields.names.size()), fields.names.data(),
+            &ContractApiDetail::getField<Object>, &ContractApiDetail::fieldDiffers<Object>};
+}
+
+// An observer of a contract's evaluators, which the node provides to measure how long they take.
+class EvaluatorObserver {
+public:
+    // The phases of an evaluator's run: Evaluate checks the operation against the chain state, and Apply, which runs
+    // only if the operation is being applied rather than just checked, changes the state
+    enum class Phase : uint8_t { Evaluate, Apply };
+
+    virtual ~EvaluatorObserver() = default;
+
+    // A phase of an evaluator for the operation with the given tag (its index in graphene::protocol::operation) ran
+    // for the given time, and threw if threw is set
+    virtual void evaluated(int64_t operationTag, Phase phase, std::chrono::nanoseconds time, bool threw) = 0;
+};
+
+// The observer to report evaluator timings to. Contracts wanting their evaluators measured define this, initialized to
+// null, and register their evaluators with registerTimedEvaluator. The node sets it while measurement is enabled.
+extern "C" BOOST_SYMBOL_EXPORT EvaluatorObserver* evaluatorObserver;
+
+// An evaluator which reports how long its evaluate and apply phases take to evaluatorObserver, if it's set; otherwise,
+// it does nothing extra.
+template<typename Evaluator>
+class TimedEvaluator : public Evaluator {
+    template<typename Phase>
+    static graphene::protocol::operation_result timed(EvaluatorObserver& observer, int64_t operationTag,
+                                                      EvaluatorObserver::Phase phase, Phase&& run) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            auto result = run();
+            observer.evaluated(operationTag, phase, std::chrono::steady_clock::now() - start, false);
+            return result;
+        } catch (...) {
+            observer.evaluated(operationTag, phase, std::chrono::steady_clock::now() - start, true);
+            throw;
+        }
+    }
+
+public:
+    graphene::protocol::operation_result start_evaluate(graphene::chain::transaction_evaluation_state& state,
+                                                        const graphene::protocol::operation& op,
+                                                        bool apply) override {
+        auto* observer = evaluatorObserver;
+        if (observer == nullptr)
+            return Evaluator::start_evaluate(state, op, apply);
+
+        // Do as generic_evaluator::start_evaluate does, timing each phase
+        try {
+            this->trx_state = &state;
+            auto result = timed(*observer, op.which(), EvaluatorObserver::Phase::Evaluate,
+                                [this, &op] { return this->evaluate(op); });
+            if (apply)
+                result = timed(*observer, op.which(), EvaluatorObserver::Phase::Apply,
+                               [this, &op] { return this->apply(op); });
+            return result;
+        } FC_CAPTURE_AND_RETHROW()
+    }
+};
+
+// Register an evaluator with the chain, measuring it if the node wants it measured
+template<typename Evaluator>
+void registerTimedEvaluator(graphene::chain::database& db) {
+    db.register_evaluator<TimedEvaluator<Evaluator>>();
+}
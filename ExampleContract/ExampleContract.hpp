@@ -23,9 +23,12 @@ public:
     }
 };
 
+// Set by the node while it's measuring our evaluators
+EvaluatorObserver* evaluatorObserver = nullptr;
+
 bool registerContract(graphene::chain::database& db, uint8_t spaceId) {
     ilog("Registering contract evaluator");
-    db.register_evaluator<ExampleContract>();
+    registerTimedEvaluator<ExampleContract>(db);
 
     return true;
 }
@@ -0,0 +1,181 @@
+#include "AsyncChangeDispatcher.hpp"
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+AsyncChangeDispatcher::AsyncChangeDispatcher() : AsyncChangeDispatcher(Options()) {}
+
+AsyncChangeDispatcher::AsyncChangeDispatcher(Options options)
+    : options(options), queue(std::max<size_t>(options.capacity, 1)) {
+    deliveryThread = std::thread([this] { run(); });
+}
+
+AsyncChangeDispatcher::~AsyncChangeDispatcher() {
+    connections.clear();
+    // Hand over everything held aside, letting the delivery thread make room in the queue as it goes
+    flush();
+    while (!overflow.empty()) {
+        wake.notify_one();
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        flush();
+    }
+    stopping = true;
+    wake.notify_one();
+    if (deliveryThread.joinable())
+        deliveryThread.join();
+}
+
+void AsyncChangeDispatcher::relay(ChainHandler::ContractDatabaseMonitor& monitor, Slot slot) {
+    size_t relay;
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        relay = slots.size();
+        slots.emplace_back(std::move(slot));
+    }
+
+    auto record = [this, relay](Operation operation) {
+        return [this, relay, operation](uint8_t typeId, const ObjectEvent& event) {
+            ChangeRecord record;
+            record.operation = operation;
+            record.typeId = typeId;
+            record.object = event.object().clone();
+            if (event.previous() != nullptr)
+                record.previous = event.previous()->clone();
+            record.relay = relay;
+            record.produced = Clock::now();
+            enqueue(std::move(record));
+        };
+    };
+    connections.emplace_back(monitor.object_created.connect(record(Operation::Created)));
+    connections.emplace_back(monitor.object_deleted.connect(record(Operation::Deleted)));
+    connections.emplace_back(monitor.object_modified.connect(record(Operation::Modified)));
+}
+
+bool AsyncChangeDispatcher::push(const ChangeRecord& record) {
+    if (!queue.push(record))
+        return false;
+    ++queued;
+    if (consumerIdle.load(std::memory_order_relaxed))
+        wake.notify_one();
+    return true;
+}
+
+void AsyncChangeDispatcher::enqueue(ChangeRecord record) {
+    ++produced;
+
+    switch (options.overflowPolicy) {
+    case OverflowPolicy::Block:
+        if (!push(record)) {
+            ++blocked;
+            while (!push(record))
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        return;
+    case OverflowPolicy::Drop:
+        if (!push(record))
+            ++dropped;
+        return;
+    case OverflowPolicy::Coalesce: {
+        // Events held aside must go first, so an object's events stay in order
+        flush();
+        if (overflow.empty() && push(record))
+            return;
+
+        auto key = std::make_pair(record.relay, record.object->id);
+        auto itr = overflow.find(key);
+        if (itr == overflow.end()) {
+            overflow.emplace(key, std::move(record));
+        } else {
+            ++coalesced;
+            if (!merge(itr->second, std::move(record)))
+                overflow.erase(itr);
+        }
+        overflowDepth = overflow.size();
+        return;
+    }
+    }
+}
+
+bool AsyncChangeDispatcher::merge(ChangeRecord& older, ChangeRecord&& newer) {
+    if (older.operation == Operation::Created && newer.operation == Operation::Deleted)
+        return false;
+
+    if (older.operation == Operation::Created) {
+        // Created, then modified: still a creation, of the latest object
+        older.object = std::move(newer.object);
+    } else if (older.operation == Operation::Deleted && newer.operation == Operation::Created) {
+        // Deleted, then created again: a modification from the deleted object to the new one
+        older.operation = Operation::Modified;
+        older.previous = std::move(older.object);
+        older.object = std::move(newer.object);
+    } else {
+        // Modified, then modified or deleted: keep the original prior state for modifications
+        older.operation = newer.operation;
+        if (newer.operation == Operation::Deleted)
+            older.previous.reset();
+        older.object = std::move(newer.object);
+    }
+    older.produced = std::min(older.produced, newer.produced);
+    return true;
+}
+
+void AsyncChangeDispatcher::flush() {
+    while (!overflow.empty() && push(overflow.begin()->second))
+        overflow.erase(overflow.begin());
+    overflowDepth = overflow.size();
+}
+
+void AsyncChangeDispatcher::deliver(const ChangeRecord& record) {
+    // Deque elements stay put as relays are added, so the slot can be used outside the lock
+    Slot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        slot = &slots[record.relay];
+    }
+
+    try {
+        (*slot)(record);
+    } catch (const fc::exception& e) {
+        elog("[AsyncChangeDispatcher] Subscriber threw while handling change: ${E}", ("E", e.to_detail_string()));
+    } catch (const std::exception& e) {
+        elog("[AsyncChangeDispatcher] Subscriber threw while handling change: ${E}", ("E", e.what()));
+    }
+
+    auto lag = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - record.produced).count();
+    lastLagMicros = lag;
+    if (lag > maxLagMicros)
+        maxLagMicros = lag;
+    ++delivered;
+}
+
+void AsyncChangeDispatcher::run() {
+    while (true) {
+        auto count = queue.consume_all([this](const ChangeRecord& record) { deliver(record); });
+        if (count > 0)
+            continue;
+        if (stopping)
+            return;
+
+        // Nothing to do; sleep until the producer wakes us. The timeout covers a wakeup racing with going idle.
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        consumerIdle = true;
+        if (queue.read_available() == 0 && !stopping)
+            wake.wait_for(lock, std::chrono::milliseconds(10));
+        consumerIdle = false;
+    }
+}
+
+AsyncChangeDispatcher::Metrics AsyncChangeDispatcher::getMetrics() const {
+    Metrics metrics;
+    metrics.depth = queued - delivered;
+    metrics.overflowDepth = overflowDepth;
+    metrics.produced = produced;
+    metrics.delivered = delivered;
+    metrics.dropped = dropped;
+    metrics.coalesced = coalesced;
+    metrics.blocked = blocked;
+    metrics.lastLag = std::chrono::microseconds(lastLagMicros.load());
+    metrics.maxLag = std::chrono::microseconds(maxLagMicros.load());
+    return metrics;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "ChainHandler.hpp"
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Delivers contract object events on a dedicated thread, so slow subscribers don't hold up block application.
+//
+// Events are copied into owned change records on the thread applying blocks, and passed through a lock-free single
+// producer, single consumer queue to the delivery thread, which invokes the subscribers. All events must therefore be
+// produced on one thread. When the queue is full, the overflow policy decides what happens to new events.
+class AsyncChangeDispatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Operation = ContractChangeSet::Operation;
+
+    enum class OverflowPolicy {
+        // Wait for the delivery thread to make room. Nothing is lost, but block application can stall.
+        Block,
+        // Discard the event
+        Drop,
+        // Hold events aside until there's room, merging events for the same object into one. Events held aside are
+        // delivered in object order rather than the order they occurred in.
+        Coalesce
+    };
+
+    struct Options {
+        // Number of events the queue can hold
+        size_t capacity = 65536;
+        OverflowPolicy overflowPolicy = OverflowPolicy::Coalesce;
+    };
+
+    // An owned copy of an object event
+    struct ChangeRecord {
+        Operation operation = Operation::Created;
+        uint8_t typeId = 0;
+        // The object after the change; for deletions, the object prior to deletion
+        std::shared_ptr<const db::object> object;
+        // For modifications, the object prior to modification; otherwise null
+        std::shared_ptr<const db::object> previous;
+        // The monitor relay the event came from, and when it was produced
+        size_t relay = 0;
+        Clock::time_point produced;
+
+        ObjectEvent event() const { return previous? ObjectEvent(*previous, *object) : ObjectEvent(*object); }
+    };
+    using Slot = std::function<void(const ChangeRecord&)>;
+
+    struct Metrics {
+        // Events in the queue, and events held aside by the coalesce policy
+        size_t depth = 0;
+        size_t overflowDepth = 0;
+        uint64_t produced = 0;
+        uint64_t delivered = 0;
+        // Events discarded by the drop policy, and merged into others by the coalesce policy
+        uint64_t dropped = 0;
+        uint64_t coalesced = 0;
+        // Number of times the block policy made the producer wait
+        uint64_t blocked = 0;
+        // Time from production to delivery, for the most recently delivered event and the worst so far
+        std::chrono::microseconds lastLag{0};
+        std::chrono::microseconds maxLag{0};
+    };
+
+    AsyncChangeDispatcher();
+    explicit AsyncChangeDispatcher(Options options);
+    // Delivers any events already queued or held aside, then stops the delivery thread
+    ~AsyncChangeDispatcher();
+
+    // Relay the created, deleted, and modified events of a contract's monitor to a slot, on the delivery thread. The
+    // monitor must outlive the dispatcher.
+    void relay(ChainHandler::ContractDatabaseMonitor& monitor, Slot slot);
+
+    // Move events held aside by the coalesce policy into the queue, as room permits. Call on the producing thread.
+    void flush();
+
+    Metrics getMetrics() const;
+
+private:
+    const Options options;
+    boost::lockfree::spsc_queue<ChangeRecord> queue;
+
+    // Producer state
+    std::vector<sig::scoped_connection> connections;
+    std::map<std::pair<size_t, db::object_id_type>, ChangeRecord> overflow;
+
+    // Consumer state; the slots are guarded as relays may be added while the delivery thread runs
+    std::mutex slotMutex;
+    std::deque<Slot> slots;
+    std::thread deliveryThread;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> consumerIdle{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    std::atomic<uint64_t> produced{0}, queued{0}, delivered{0}, dropped{0}, coalesced{0}, blocked{0};
+    std::atomic<size_t> overflowDepth{0};
+    std::atomic<int64_t> lastLagMicros{0}, maxLagMicros{0};
+
+    // Hand a record to the queue according to the overflow policy
+    void enqueue(ChangeRecord record);
+    bool push(const ChangeRecord& record);
+    // Merge a newer record for an object into an older one held aside. Returns false if the two cancel out.
+    static bool merge(ChangeRecord& older, ChangeRecord&& newer);
+    void deliver(const ChangeRecord& record);
+    void run();
+};
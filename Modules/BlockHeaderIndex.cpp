@@ -0,0 +1,107 @@
+#include "BlockHeaderIndex.hpp"
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace BIP = boost::interprocess;
+
+void BlockHeaderIndex::open(const fc::path& file) {
+    close();
+    path = file;
+
+    bool fresh = !fc::exists(path) || fc::file_size(path) < sizeof(Record);
+    if (fresh) {
+        fc::create_directories(path.parent_path());
+        std::ofstream(path.string(), std::ios::binary | std::ios::trunc).close();
+        fc::resize_file(path, GROWTH_RECORDS * sizeof(Record));
+    }
+    map();
+
+    auto& header = fileHeader();
+    if (!fresh && (header.magic != MAGIC || header.version != VERSION || header.recordSize != sizeof(Record))) {
+        wlog("[BlockHeaderIndex] Index at ${P} is not in a format we recognize; starting it over", ("P", path));
+        std::memset(region->get_address(), 0, region->get_size());
+        fresh = true;
+    }
+    if (fresh)
+        header = {MAGIC, VERSION, static_cast<uint32_t>(sizeof(Record)), 0};
+}
+
+void BlockHeaderIndex::close() {
+    if (region)
+        region->flush();
+    region.reset();
+    mapping.reset();
+}
+
+void BlockHeaderIndex::append(const signed_block& block) {
+    FC_ASSERT(isOpen(), "[BlockHeaderIndex] Index used before being opened!");
+    auto blockNum = block.block_num();
+    if (blockNum >= capacity())
+        grow(blockNum + 1);
+
+    auto& entry = record(blockNum);
+    entry.blockNum = blockNum;
+    entry.timestamp = block.timestamp.sec_since_epoch();
+    std::memcpy(entry.id, block.id().data(), sizeof(entry.id));
+    std::memcpy(entry.previous, block.previous.data(), sizeof(entry.previous));
+    entry.witness = block.witness.instance.value;
+
+    fileHeader().headBlockNum = blockNum;
+}
+
+void BlockHeaderIndex::truncate(uint32_t headBlockNum) {
+    if (isOpen())
+        fileHeader().headBlockNum = std::min(fileHeader().headBlockNum, headBlockNum);
+}
+
+uint32_t BlockHeaderIndex::headBlockNum() const {
+    if (!isOpen())
+        return 0;
+    if (chainHead)
+        return std::min(fileHeader().headBlockNum, chainHead());
+    return fileHeader().headBlockNum;
+}
+
+std::optional<BlockHeaderIndex::Header> BlockHeaderIndex::find(uint32_t blockNum) const {
+    if (blockNum == 0 || blockNum > headBlockNum() || blockNum >= capacity())
+        return {};
+
+    const auto& entry = record(blockNum);
+    if (entry.blockNum != blockNum)
+        return {};
+
+    Header header;
+    header.blockNum = entry.blockNum;
+    std::memcpy(header.id.data(), entry.id, sizeof(entry.id));
+    header.timestamp = fc::time_point_sec(entry.timestamp);
+    std::memcpy(header.previous.data(), entry.previous, sizeof(entry.previous));
+    header.witness = graphene::protocol::witness_id_type(entry.witness);
+    return header;
+}
+
+std::optional<BlockHeaderIndex::Header> BlockHeaderIndex::find(const block_id_type& blockId) const {
+    auto header = find(graphene::protocol::block_header::num_from_id(blockId));
+    if (header && header->id == blockId)
+        return header;
+    return {};
+}
+
+void BlockHeaderIndex::map() {
+    region.reset();
+    mapping.reset();
+    mapping = std::make_unique<BIP::file_mapping>(path.string().c_str(), BIP::read_write);
+    region = std::make_unique<BIP::mapped_region>(*mapping, BIP::read_write);
+}
+
+void BlockHeaderIndex::grow(size_t minimumRecords) {
+    auto newCapacity = std::max(minimumRecords, capacity() + GROWTH_RECORDS);
+    region->flush();
+    region.reset();
+    mapping.reset();
+    fc::resize_file(path, newCapacity * sizeof(Record));
+    map();
+}
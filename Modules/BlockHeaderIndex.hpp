@@ -0,0 +1,88 @@
+#pragma once
+
+#include <graphene/protocol/block.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <functional>
+#include <memory>
+#include <optional>
+
+// A memory-mapped file of block headers, one fixed-size record per block, indexed by block number.
+//
+// It holds the parts of a header that queries commonly want -- number, ID, timestamp, previous ID, and witness -- so
+// those queries can be answered from a single record instead of loading the full block from the block log. Records are
+// appended as blocks are applied; a record is replaced if a fork switch applies a different block at that height.
+class BlockHeaderIndex {
+public:
+    using block_id_type = graphene::protocol::block_id_type;
+    using signed_block = graphene::protocol::signed_block;
+
+    struct Header {
+        uint32_t blockNum = 0;
+        block_id_type id;
+        fc::time_point_sec timestamp;
+        block_id_type previous;
+        graphene::protocol::witness_id_type witness;
+    };
+
+    BlockHeaderIndex() = default;
+    ~BlockHeaderIndex() { close(); }
+
+    // Open the index file, creating it if it doesn't exist
+    void open(const fc::path& file);
+    void close();
+    bool isOpen() const { return region != nullptr; }
+
+    // Record the header of a block which has been applied, and is now the head block
+    void append(const signed_block& block);
+    // Forget all records after the given block number
+    void truncate(uint32_t headBlockNum);
+    // Bound lookups by the chain's head block number, as reported by the given function. The chain doesn't signal when
+    // it pops blocks, so without this, the records of popped blocks are found until new blocks replace them.
+    void followChainHead(std::function<uint32_t()> chainHead) { this->chainHead = std::move(chainHead); }
+
+    // Number of the newest block in the index, or zero if empty
+    uint32_t headBlockNum() const;
+    // Get the header of the block with the given number, if it's in the index
+    std::optional<Header> find(uint32_t blockNum) const;
+    // Get the header of the block with the given ID, if it's in the index
+    std::optional<Header> find(const block_id_type& blockId) const;
+
+private:
+    // On-disk record format. This is the file format, so don't change it without bumping VERSION.
+    struct Record {
+        uint32_t blockNum;
+        uint32_t timestamp;
+        char id[20];
+        char previous[20];
+        uint64_t witness;
+    };
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t headBlockNum;
+    };
+    static_assert(sizeof(FileHeader) <= sizeof(Record), "File header must fit in the first record slot");
+    constexpr static uint32_t MAGIC = 0x49484250; // "PBHI"
+    constexpr static uint32_t VERSION = 1;
+    // Grow the file by at least this many records at a time
+    constexpr static size_t GROWTH_RECORDS = 64 * 1024;
+
+    fc::path path;
+    std::function<uint32_t()> chainHead;
+    std::unique_ptr<boost::interprocess::file_mapping> mapping;
+    std::unique_ptr<boost::interprocess::mapped_region> region;
+
+    size_t capacity() const { return region? region->get_size() / sizeof(Record) : 0; }
+    FileHeader& fileHeader() const { return *reinterpret_cast<FileHeader*>(region->get_address()); }
+    Record& record(uint32_t blockNum) const {
+        return reinterpret_cast<Record*>(region->get_address())[blockNum];
+    }
+    void map();
+    void grow(size_t minimumRecords);
+};
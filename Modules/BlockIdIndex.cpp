@@ -0,0 +1,46 @@
+#include "BlockIdIndex.hpp"
+
+#include <algorithm>
+
+BlockIdIndex::BlockIdIndex(size_t capacity) : ring(std::max<size_t>(capacity, 1)) {}
+
+void BlockIdIndex::setHead(uint32_t blockNum, const block_id_type& blockId) {
+    if (blockNum == 0)
+        return clear();
+
+    // If the new head doesn't continue or rewind what we have, start over from it
+    if (empty() || blockNum < lowNum || blockNum > highNum + 1)
+        lowNum = blockNum;
+    highNum = blockNum;
+    ring[slot(blockNum)] = blockId;
+
+    if (size() > ring.size())
+        lowNum = highNum - ring.size() + 1;
+}
+
+void BlockIdIndex::truncate(uint32_t headBlockNum) {
+    if (empty() || headBlockNum >= highNum)
+        return;
+    if (headBlockNum < lowNum)
+        return clear();
+    highNum = headBlockNum;
+}
+
+std::optional<BlockIdIndex::block_id_type> BlockIdIndex::find(uint32_t blockNum) const {
+    if (empty() || blockNum < lowNum || blockNum > highNum)
+        return {};
+    return ring[slot(blockNum)];
+}
+
+bool BlockIdIndex::copyRange(uint32_t first, uint32_t last, std::vector<block_id_type>& out) const {
+    if (empty() || first > last || first < lowNum || last > highNum)
+        return false;
+
+    // The range is at most two contiguous runs in the ring: up to the end of the ring, then from its beginning
+    auto begin = ring.begin() + slot(first);
+    auto count = size_t(last - first) + 1;
+    auto firstRun = std::min<size_t>(count, ring.end() - begin);
+    out.insert(out.end(), begin, begin + firstRun);
+    out.insert(out.end(), ring.begin(), ring.begin() + (count - firstRun));
+    return true;
+}
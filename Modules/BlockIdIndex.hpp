@@ -0,0 +1,47 @@
+#pragma once
+
+#include <graphene/protocol/types.hpp>
+
+#include <optional>
+#include <vector>
+
+// An in-memory index of block number to block ID for the most recent blocks in the chain.
+//
+// IDs are held in a ring, contiguous by block number, ending at the head block. Looking up a block ID is a single array
+// access, and fetching a run of IDs is at most two contiguous copies, rather than a database lookup per block.
+class BlockIdIndex {
+public:
+    using block_id_type = graphene::protocol::block_id_type;
+
+    // Create an index holding up to capacity block IDs
+    BlockIdIndex(size_t capacity);
+
+    // Record that the block with the given number and ID is now the head block. Any IDs recorded for blocks after it
+    // are forgotten, so this handles fork switches as well as new blocks.
+    void setHead(uint32_t blockNum, const block_id_type& blockId);
+    // Forget the IDs of all blocks after the given block number, i.e. when blocks are popped from the chain
+    void truncate(uint32_t headBlockNum);
+    // Forget all block IDs
+    void clear() { lowNum = 1; highNum = 0; }
+
+    // Get the ID of the block with the given number, if it's in the index
+    std::optional<block_id_type> find(uint32_t blockNum) const;
+    // Append the IDs of blocks first through last, inclusive, to out. Returns false, appending nothing, if any of those
+    // blocks are not in the index.
+    bool copyRange(uint32_t first, uint32_t last, std::vector<block_id_type>& out) const;
+
+    bool empty() const { return highNum < lowNum; }
+    size_t size() const { return empty()? 0 : highNum - lowNum + 1; }
+    size_t capacity() const { return ring.size(); }
+    // Lowest and highest block numbers in the index. Meaningless if the index is empty.
+    uint32_t lowestBlockNum() const { return lowNum; }
+    uint32_t highestBlockNum() const { return highNum; }
+
+private:
+    std::vector<block_id_type> ring;
+    // Block numbers of the oldest and newest IDs in the ring
+    uint32_t lowNum = 1;
+    uint32_t highNum = 0;
+
+    size_t slot(uint32_t blockNum) const { return blockNum % ring.size(); }
+};
@@ -0,0 +1,37 @@
+#include "BlockMessageCache.hpp"
+
+std::optional<graphene::net::message> BlockMessageCache::find(const block_id_type& blockId) {
+    auto itr = index.find(blockId);
+    if (itr == index.end()) {
+        ++counters.misses;
+        return {};
+    }
+
+    ++counters.hits;
+    entries.splice(entries.begin(), entries, itr->second);
+    return itr->second->second;
+}
+
+const graphene::net::message& BlockMessageCache::insert(const signed_block& block) {
+    auto blockId = block.id();
+    auto itr = index.find(blockId);
+    if (itr != index.end()) {
+        entries.splice(entries.begin(), entries, itr->second);
+        return itr->second->second;
+    }
+
+    entries.emplace_front(blockId, graphene::net::message(graphene::net::block_message(block)));
+    index.emplace(blockId, entries.begin());
+    counters.bytes += entries.front().second.data.size();
+
+    // Evict the least recently used messages until we're within budget, but always keep the one we just added
+    while (counters.bytes > maxBytes && entries.size() > 1) {
+        const auto& oldest = entries.back();
+        counters.bytes -= oldest.second.data.size();
+        ++counters.evicted;
+        index.erase(oldest.first);
+        entries.pop_back();
+    }
+
+    return entries.front().second;
+}
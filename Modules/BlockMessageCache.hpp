@@ -0,0 +1,49 @@
+#pragma once
+
+#include <graphene/net/message.hpp>
+#include <graphene/net/core_messages.hpp>
+
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+// A least-recently-used cache of serialized block messages, bounded by total message size.
+//
+// Recent blocks get requested by every peer we're connected to, so rather than loading and serializing a block anew for
+// each request, we keep the ready-to-send message around.
+class BlockMessageCache {
+public:
+    using block_id_type = graphene::protocol::block_id_type;
+    using signed_block = graphene::protocol::signed_block;
+
+    struct Counters {
+        // Lookups which found the message in the cache
+        uint64_t hits = 0;
+        // Lookups which did not
+        uint64_t misses = 0;
+        // Total size of the messages currently in the cache
+        uint64_t bytes = 0;
+        // Messages dropped to stay within the size limit
+        uint64_t evicted = 0;
+    };
+
+    // maxBytes bounds the total size of the cached messages
+    BlockMessageCache(size_t maxBytes = 64 * 1024 * 1024) : maxBytes(maxBytes) {}
+
+    // Get the message for the given block, if it's cached
+    std::optional<graphene::net::message> find(const block_id_type& blockId);
+    // Serialize a block and add its message to the cache. Returns the message.
+    const graphene::net::message& insert(const signed_block& block);
+
+    size_t size() const { return entries.size(); }
+    const Counters& getCounters() const { return counters; }
+
+private:
+    const size_t maxBytes;
+
+    using Entry = std::pair<block_id_type, graphene::net::message>;
+    // Cached messages, most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<block_id_type, std::list<Entry>::iterator> index;
+    Counters counters;
+};
@@ -0,0 +1,124 @@
+#include "BlockPipeline.hpp"
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+BlockPipeline::BlockPipeline(WorkerPool& workers, ApplyFunction apply, size_t depth)
+    : workers(workers), apply(std::move(apply)), depth(std::max<size_t>(depth, 1)) {
+    consumer = fc::async([this] { consume(); }, "Block pipeline consumer");
+}
+
+BlockPipeline::~BlockPipeline() {
+    stop();
+}
+
+void BlockPipeline::submit(signed_block block, const chain_id_type& chainId) {
+    // Wait for room in the pipeline
+    while (!stopped && queue.size() >= depth) {
+        if (!roomAvailable || roomAvailable->ready())
+            roomAvailable = fc::promise<void>::create("Block pipeline room available");
+        auto room = roomAvailable;
+        room->wait();
+    }
+    if (stopped)
+        return;
+
+    // Stage one: stateless checks, off on the worker pool
+    auto sharedBlock = std::make_shared<signed_block>(std::move(block));
+    std::vector<fc::future<void>> prevalidated;
+    prevalidated.push_back(workers.run([sharedBlock] { prevalidateHeader(*sharedBlock); }, "Block pre-validation"));
+
+    // Split the signature recovery into batches across the pool
+    auto trxCount = sharedBlock->transactions.size();
+    auto batchSize = std::max(MIN_RECOVERY_BATCH, (trxCount + workers.size() - 1) / workers.size());
+    for (size_t begin = 0; begin < trxCount; begin += batchSize) {
+        auto end = std::min(begin + batchSize, trxCount);
+        prevalidated.push_back(workers.run([sharedBlock, begin, end, chainId] {
+            recoverSignatures(*sharedBlock, begin, end, chainId);
+        }, "Transaction signature recovery"));
+    }
+
+    queue.push_back({std::move(sharedBlock), std::move(prevalidated)});
+
+    if (workAvailable && !workAvailable->ready())
+        workAvailable->set_value();
+}
+
+void BlockPipeline::stop() {
+    if (stopped)
+        return;
+    stopped = true;
+
+    // Wake anyone waiting on the pipeline so they notice it's stopped
+    if (roomAvailable && !roomAvailable->ready())
+        roomAvailable->set_value();
+    if (workAvailable && !workAvailable->ready())
+        workAvailable->set_value();
+    if (released && !released->ready())
+        released->set_value();
+    if (consumer.valid())
+        consumer.wait();
+
+    if (!queue.empty())
+        wlog("Block pipeline stopped with ${n} blocks not yet applied", ("n", queue.size()));
+    queue.clear();
+}
+
+void BlockPipeline::release() {
+    if (holds == 0 || --holds > 0)
+        return;
+    if (released && !released->ready())
+        released->set_value();
+}
+
+void BlockPipeline::prevalidateHeader(const signed_block& block) {
+    FC_ASSERT(block.calculate_merkle_root() == block.transaction_merkle_root,
+              "Transaction Merkle root of block #${num} does not match its transactions", ("num", block.block_num()));
+
+    // These calls cache their results within the block, so the chain won't redo the work
+    block.id();
+    block.signee();
+}
+
+void BlockPipeline::recoverSignatures(const signed_block& block, size_t begin, size_t end,
+                                      const chain_id_type& chainId) {
+    // As with the header, the transactions cache their IDs and signees, and the chain uses the cached values
+    for (size_t i = begin; i < end; ++i) {
+        const auto& trx = block.transactions[i];
+        trx.id();
+        trx.get_signature_keys(chainId);
+    }
+}
+
+void BlockPipeline::consume() {
+    while (!stopped) {
+        if (queue.empty()) {
+            workAvailable = fc::promise<void>::create("Block pipeline work available");
+            workAvailable->wait();
+            continue;
+        }
+
+        auto entry = std::move(queue.front());
+        queue.pop_front();
+        applying = true;
+        if (roomAvailable && !roomAvailable->ready())
+            roomAvailable->set_value();
+
+        // Stage two: strictly in order, on our own thread
+        try {
+            for (auto& stage : entry.prevalidated)
+                stage.wait();
+            while (holds > 0 && !stopped) {
+                released = fc::promise<void>::create("Block pipeline released");
+                released->wait();
+            }
+            if (!stopped)
+                apply(*entry.block);
+        } catch (const fc::exception& e) {
+            wlog("Discarding block #${num} which failed pre-validation: ${e}",
+                 ("num", entry.block->block_num())("e", e.to_detail_string()));
+        }
+        applying = false;
+    }
+}
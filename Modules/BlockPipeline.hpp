@@ -0,0 +1,75 @@
+#pragma once
+
+#include "WorkerPool.hpp"
+
+#include <graphene/protocol/block.hpp>
+
+#include <fc/thread/future.hpp>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// A two-stage pipeline for ingesting blocks from the network.
+//
+// Stage one runs the stateless checks on a block -- the transaction Merkle root, recovery of the witness and
+// transaction signing keys, and transaction digests -- on a WorkerPool, for many blocks at once. Signature recovery for
+// a block's transactions is split into batches spread across the pool, so even a single large block uses every worker.
+// The recovered keys and digests are cached within the block itself, so the chain does not recompute them when it
+// applies the block. Stage two hands the pre-validated blocks, strictly in the order they were submitted, to the apply
+// callback, which is run on the thread that created the pipeline.
+//
+// At most `depth` blocks may be in the pipeline at once. When it is full, submit() waits for room, which propagates
+// backpressure to whoever is submitting blocks.
+class BlockPipeline {
+public:
+    using signed_block = graphene::protocol::signed_block;
+    using chain_id_type = graphene::protocol::chain_id_type;
+    using ApplyFunction = std::function<void(const signed_block&)>;
+
+    // Fewest transactions worth recovering signatures for in a task of their own
+    constexpr static size_t MIN_RECOVERY_BATCH = 16;
+
+    BlockPipeline(WorkerPool& workers, ApplyFunction apply, size_t depth = 64);
+    ~BlockPipeline();
+
+    // Submit a block to the pipeline. Blocks (cooperatively) while the pipeline is full.
+    void submit(signed_block block, const chain_id_type& chainId);
+    // Stop the pipeline. Blocks which have not yet been applied are discarded.
+    void stop();
+    // Stop applying blocks until release() is called. Blocks submitted meanwhile are still pre-validated, and submit()
+    // waits once the pipeline fills, as usual. Holds nest; blocks are applied again once every hold is released.
+    void hold() { ++holds; }
+    void release();
+
+    // Number of blocks submitted but not yet applied
+    size_t size() const { return queue.size() + (applying? 1 : 0); }
+
+    // Run the stateless checks on the block header, caching the results within it. Throws if the block is invalid.
+    static void prevalidateHeader(const signed_block& block);
+    // Recover the signing keys of transactions [begin, end) in the block, caching them within the transactions
+    static void recoverSignatures(const signed_block& block, size_t begin, size_t end, const chain_id_type& chainId);
+
+private:
+    struct Entry {
+        std::shared_ptr<signed_block> block;
+        // Stage one tasks for this block; the block is ready to apply when all of them have completed
+        std::vector<fc::future<void>> prevalidated;
+    };
+
+    WorkerPool& workers;
+    ApplyFunction apply;
+    const size_t depth;
+
+    std::deque<Entry> queue;
+    bool applying = false;
+    bool stopped = false;
+    unsigned holds = 0;
+    fc::promise<void>::ptr released;
+    fc::promise<void>::ptr roomAvailable;
+    fc::promise<void>::ptr workAvailable;
+    fc::future<void> consumer;
+
+    void consume();
+};
@@ -0,0 +1,65 @@
+#include "BlockReorderBuffer.hpp"
+
+bool BlockReorderBuffer::insert(const signed_block& block, uint32_t headBlockNum) {
+    auto blockNum = block.block_num();
+
+    // Only keep blocks which are ahead of the head, but not unreasonably far ahead
+    if (blockNum <= headBlockNum + 1 || blockNum - headBlockNum > maxLookahead) {
+        ++counters.evicted;
+        return false;
+    }
+
+    auto itr = blocks.find(blockNum);
+    if (itr != blocks.end()) {
+        // Already have this one
+        if (itr->second.id() == block.id())
+            return true;
+        // A competing block at the same height; keep the newer arrival, as it's more likely to be on the live fork
+        itr->second = block;
+        ++counters.evicted;
+        ++counters.buffered;
+        return true;
+    }
+
+    if (blocks.size() >= maxBlocks) {
+        // Make room by dropping the block furthest from the head, unless that's the block we were given
+        auto last = std::prev(blocks.end());
+        if (last->first < blockNum) {
+            ++counters.evicted;
+            return false;
+        }
+        blocks.erase(last);
+        ++counters.evicted;
+    }
+
+    blocks.emplace(blockNum, block);
+    ++counters.buffered;
+    return true;
+}
+
+std::optional<BlockReorderBuffer::signed_block> BlockReorderBuffer::takeNext(const block_id_type& headBlockId,
+                                                                             uint32_t headBlockNum) {
+    // Drop anything which is at or behind the head; it's either applied already or on a dead fork
+    while (!blocks.empty() && blocks.begin()->first <= headBlockNum) {
+        blocks.erase(blocks.begin());
+        ++counters.evicted;
+    }
+
+    if (blocks.empty() || blocks.begin()->first != headBlockNum + 1)
+        return {};
+
+    auto node = blocks.extract(blocks.begin());
+    if (node.mapped().previous != headBlockId) {
+        // Right height, but it doesn't link to our head
+        ++counters.evicted;
+        return {};
+    }
+
+    ++counters.drained;
+    return std::move(node.mapped());
+}
+
+void BlockReorderBuffer::clear() {
+    counters.evicted += blocks.size();
+    blocks.clear();
+}
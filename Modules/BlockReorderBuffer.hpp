@@ -0,0 +1,47 @@
+#pragma once
+
+#include <graphene/protocol/block.hpp>
+
+#include <map>
+#include <optional>
+
+// Holds blocks which arrived ahead of the chain head, so they can be applied once the gap before them is filled
+// rather than being discarded and fetched again from the network.
+class BlockReorderBuffer {
+public:
+    using signed_block = graphene::protocol::signed_block;
+    using block_id_type = graphene::protocol::block_id_type;
+
+    struct Counters {
+        // Number of blocks accepted into the buffer
+        uint64_t buffered = 0;
+        // Number of blocks taken back out of the buffer to be applied
+        uint64_t drained = 0;
+        // Number of blocks rejected or discarded due to the buffer's limits, or because they went stale
+        uint64_t evicted = 0;
+    };
+
+    // maxBlocks bounds the number of blocks held at once; maxLookahead bounds how far ahead of the head a block may be
+    BlockReorderBuffer(size_t maxBlocks = 1000, uint32_t maxLookahead = 10000)
+        : maxBlocks(maxBlocks), maxLookahead(maxLookahead) {}
+
+    // Buffer a block which is ahead of the head block. Returns true if the block was kept.
+    bool insert(const signed_block& block, uint32_t headBlockNum);
+    // Remove and return the block which links onto the provided head, if we have it.
+    // Any buffered blocks which can no longer be applied after this head are evicted.
+    std::optional<signed_block> takeNext(const block_id_type& headBlockId, uint32_t headBlockNum);
+    // Discard all buffered blocks
+    void clear();
+
+    size_t size() const { return blocks.size(); }
+    bool empty() const { return blocks.empty(); }
+    const Counters& getCounters() const { return counters; }
+
+private:
+    const size_t maxBlocks;
+    const uint32_t maxLookahead;
+
+    // Buffered blocks, keyed by block number
+    std::map<uint32_t, signed_block> blocks;
+    Counters counters;
+};
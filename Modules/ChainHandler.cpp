@@ -1,11 +1,17 @@
 #include "ChainHandler.hpp"
+#include "ContractJournal.hpp"
+#include "NodeSnapshot.hpp"
+#include "GenesisCache.hpp"
+#include "WorkerPool.hpp"
 
+#include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 
 #include <fc/io/fstream.hpp>
 
 #include <boost/multi_index/indexed_by.hpp>
+#include <algorithm>
 #include <limits>
 
 constexpr static uint8_t CONTRACT_RECORD_TYPE_ID = 0;
@@ -41,16 +47,92 @@ using ContractRecordIndex = db::primary_index<
 
 ChainHandler::ChainHandler() {}
 ChainHandler::~ChainHandler() {
+    journalMonitors.clear();
+    journal.reset();
     chain.close();
     persistence.flush();
     persistence.close();
+    if (isOpen)
+        fc::remove(dirtyMarkerPath());
 }
 
 void ChainHandler::initialize() {
+    if (fc::exists(dirtyMarkerPath()))
+        recoverFromCheckpoint();
+
     persistence.add_index<ContractRecordIndex>();
     persistence.open(persistencePath());
 }
 
+void ChainHandler::recoverFromCheckpoint() {
+    wlog("[ChainHandler] The node did not shut down cleanly; looking for a checkpoint to recover from");
+    checkpointer.open(checkpointsPath());
+
+    chain::block_database blocks;
+    blocks.open(chainPath() / "database" / "block_num_to_block");
+    auto checkpoint = checkpointer.findLatest([&blocks](uint32_t, const protocol::block_id_type& id) {
+        return blocks.contains(id);
+    });
+    if (!checkpoint.has_value()) {
+        blocks.close();
+        wlog("[ChainHandler] No usable checkpoint; opening the databases as they were left");
+        return;
+    }
+
+    // The chain won't open unless its newest block is its head block, so move the blocks after the checkpoint out of
+    // the block database, to be applied again once it's open. They go to the recovery store first, and only leave the
+    // block database once the store is on disk. A store left by an earlier recovery which didn't finish may already
+    // hold them, and more besides; it's added to, not replaced.
+    chain::block_database recovery;
+    recovery.open(recoveryBlocksPath());
+    std::vector<protocol::block_id_type> moved;
+    for (auto num = checkpoint->blockNum + 1;; ++num) {
+        auto block = blocks.fetch_by_number(num);
+        if (!block.valid())
+            break;
+        moved.push_back(block->id());
+        if (!recovery.contains(moved.back()))
+            recovery.store(moved.back(), *block);
+    }
+    recovery.flush();
+    recovery.close();
+    for (auto itr = moved.rbegin(); itr != moved.rend(); ++itr)
+        blocks.remove(*itr);
+    blocks.close();
+
+    StateCheckpointer::restore(*checkpoint, chainPath(), persistencePath());
+    ilog("[ChainHandler] Restored checkpoint at block ${N}; the blocks after it will be applied again",
+         ("N", checkpoint->blockNum));
+}
+
+void ChainHandler::applyRecoveryBlocks() {
+    chain::block_database recovery;
+    recovery.open(recoveryBlocksPath());
+    // These blocks were validated when they were first applied
+    auto skip = chain::database::skip_witness_signature | chain::database::skip_transaction_signatures |
+                chain::database::skip_transaction_dupe_check | chain::database::skip_tapos_check |
+                chain::database::skip_authority_check;
+    auto first = chain.head_block_num() + 1;
+    auto num = first;
+    for (;; ++num) {
+        auto block = recovery.fetch_by_number(num);
+        if (!block.valid())
+            break;
+        try {
+            chain.push_block(*block, skip);
+        } catch (const fc::exception& e) {
+            // Keep the store, so the blocks can be applied on a later attempt rather than downloaded again
+            recovery.close();
+            elog("[ChainHandler] Failed to reapply block ${N} after the recovered checkpoint; the remaining blocks are"
+                 " kept in ${P}", ("N", num)("P", recoveryBlocksPath()));
+            throw;
+        }
+    }
+    recovery.close();
+    fc::remove_all(recoveryBlocksPath());
+    ilog("[ChainHandler] Applied ${N} blocks after the recovered checkpoint", ("N", num - first));
+}
+
 void ChainHandler::open() {
     auto computeGenesis = [this] {
         using namespace graphene::chain;
@@ -59,10 +141,7 @@ void ChainHandler::open() {
         auto genesisPath = chainPath().parent_path() / "genesis.json";
         if (fc::is_regular_file(genesisPath)) {
             ilog("Using genesis at ${G}", ("G", genesisPath));
-
-            auto genesis = fc::json::from_file(genesisPath).as<genesis_state_type>(MAX_RECURSION_DEPTH);
-            genesis.initial_chain_id = fc::sha256::hash(fc::json::to_string(genesis) + "\n");
-            return genesis;
+            return GenesisCache::load(genesisPath, genesisCachePath(), MAX_RECURSION_DEPTH);
         }
 
         auto genesisKey = fc::ecc::private_key::regenerate(fc::sha256::hash("Pollaris Development Key"));
@@ -85,16 +164,171 @@ void ChainHandler::open() {
         genesisFile.close();
 
         genesis.initial_chain_id = fc::sha256::hash(genesisString);
+        try {
+            GenesisCache::store(genesisCachePath(), genesisString, genesis);
+        } catch (const fc::exception& e) {
+            wlog("[ChainHandler] Could not write genesis cache: ${E}", ("E", e.to_string()));
+        }
         return genesis;
     };
 
     ilog("[ChainHandler] Opening chain with data directory ${D}", ("D", chainPath()));
     chain.open(chainPath(), computeGenesis, GRAPHENE_CURRENT_DB_VERSION);
     isOpen = true;
+    fc::ofstream(dirtyMarkerPath()).close();
+    if (snapshotChainId.has_value())
+        FC_ASSERT(chain.get_chain_id() == *snapshotChainId,
+                  "[ChainHandler] Restored chain has ID ${C}, but the snapshot was of chain ${S}",
+                  ("C", chain.get_chain_id())("S", *snapshotChainId));
+
+    headerIndex.open(headerIndexPath());
+    syncHeaderIndex();
+    chain.applied_block.connect([this](const chain::signed_block& block) { headerIndex.append(block); });
+    headerIndex.followChainHead([this] { return chain.head_block_num(); });
+
+    if (journalEnabled) {
+        journal = std::make_unique<ContractJournal>();
+        journal->open(journalPath());
+        syncJournal();
+        for (const auto& [spaceId, name] : contracts.names())
+            journalContract(spaceId, name);
+        chain.applied_block.connect([this](const chain::signed_block& block) {
+            journal->blockApplied(block.block_num(), block.id());
+        });
+    }
+
+    if (fc::exists(recoveryBlocksPath()))
+        applyRecoveryBlocks();
+
+    if (checkpointsEnabled) {
+        checkpointer.open(checkpointsPath());
+        chain.applied_block.connect([this](const chain::signed_block& block) {
+            checkpointer.blockApplied(block.block_num(), block.id(), chain, persistence);
+        });
+    }
+}
+
+void ChainHandler::exportSnapshot(const fc::path& snapshotFile) {
+    FC_ASSERT(isOpen, "[ChainHandler] Cannot export a snapshot before the chain is opened");
+    auto start = fc::time_point::now();
+    chain.flush();
+    persistence.flush();
+
+    // Take the object databases, the header index, and the genesis, but not the block database: the snapshot's head
+    // block is all a restored node needs of it
+    std::vector<std::string> files;
+    auto base = basePath.generic_string() + "/";
+    auto addFile = [&files, &base](const fc::path& file) {
+        auto path = file.generic_string();
+        FC_ASSERT(path.compare(0, base.size(), base) == 0, "[ChainHandler] File ${F} is not in the config path",
+                  ("F", path));
+        files.emplace_back(path.substr(base.size()));
+    };
+    auto blockDatabase = (chainPath() / "database").generic_string() + "/";
+    for (fc::recursive_directory_iterator itr(chainPath()); itr != fc::recursive_directory_iterator(); ++itr)
+        if (fc::is_regular_file(*itr) && (*itr).generic_string().compare(0, blockDatabase.size(), blockDatabase) != 0)
+            addFile(*itr);
+    for (fc::recursive_directory_iterator itr(persistencePath()); itr != fc::recursive_directory_iterator(); ++itr)
+        if (fc::is_regular_file(*itr))
+            addFile(*itr);
+    for (const auto& file : {headerIndexPath(), basePath / "genesis.json"})
+        if (fc::is_regular_file(file))
+            addFile(file);
+
+    auto headBlock = chain.fetch_block_by_id(chain.head_block_id());
+    FC_ASSERT(headBlock.valid(), "[ChainHandler] Could not load head block to export snapshot");
+
+    std::vector<NodeSnapshot::Contract> contracts;
+    persistence.get_index_type<ContractRecordIndex>().inspect_all_objects([&contracts](const db::object& object) {
+        const auto& record = static_cast<const ContractRecord&>(object);
+        contracts.push_back({record.contractObjectSpaceId(), record.name});
+    });
+
+    WorkerPool workers(0, "Snapshot");
+    auto manifest = NodeSnapshot::write(snapshotFile, basePath, files, *headBlock, chain.get_chain_id(),
+                                        std::move(contracts), workers);
+    ilog("[ChainHandler] Exported snapshot at block ${N} with ${F} files to ${P} in ${T}ms",
+         ("N", manifest.headBlockNum)("F", files.size())("P", snapshotFile)
+         ("T", (fc::time_point::now() - start).count() / 1000));
+}
+
+void ChainHandler::importSnapshot(const fc::path& snapshotFile) {
+    FC_ASSERT(!isOpen, "[ChainHandler] Cannot import a snapshot after the databases are opened");
+    FC_ASSERT(!hasChainState(), "[ChainHandler] Cannot import a snapshot over an existing chain at ${P}",
+              ("P", chainPath()));
+    auto start = fc::time_point::now();
+
+    WorkerPool workers(0, "Snapshot");
+    auto restored = NodeSnapshot::restore(snapshotFile, basePath, workers);
+
+    // The chain opens its block database at its head block, so put the snapshot's head block there
+    chain::block_database blocks;
+    blocks.open(chainPath() / "database" / "block_num_to_block");
+    blocks.store(restored.headBlock.id(), restored.headBlock);
+    blocks.close();
+
+    snapshotChainId = restored.manifest.chainId;
+    ilog("[ChainHandler] Imported snapshot of chain ${C} at block ${N}, with ${K} contracts, from ${P} in ${T}ms",
+         ("C", restored.manifest.chainId)("N", restored.manifest.headBlockNum)
+         ("K", restored.manifest.contracts.size())("P", snapshotFile)
+         ("T", (fc::time_point::now() - start).count() / 1000));
+}
+
+void ChainHandler::syncJournal() {
+    auto num = std::min(journal->headBlockNum(), chain.head_block_num());
+    while (num > 0) {
+        auto id = journal->blockId(num);
+        if (!id.has_value() || *id == chain.get_block_id_for_num(num))
+            break;
+        --num;
+    }
+    journal->truncate(num);
+
+    if (journal->headBlockNum() > 0 && journal->headBlockNum() < chain.head_block_num())
+        wlog("[ChainHandler] Contract journal ends at block ${J}, but the chain is at block ${C}. Changes in between"
+             " were not journaled.", ("J", journal->headBlockNum())("C", chain.head_block_num()));
+}
+
+void ChainHandler::journalContract(uint8_t spaceId, const std::string& name) {
+    auto monitor = observeContract(spaceId, name);
+    monitor->block_changes.connect([this](const std::shared_ptr<const ContractChangeSet>& changeSet) {
+        journal->record(*changeSet);
+    });
+    journalMonitors.emplace_back(std::move(monitor));
+}
+
+void ChainHandler::syncHeaderIndex() {
+    auto chainHead = chain.head_block_num();
+    auto indexHead = std::min(headerIndex.headBlockNum(), chainHead);
+
+    // If the index disagrees with the chain about the head, it's from some other chain state. Start it over.
+    if (indexHead > 0) {
+        auto header = headerIndex.find(indexHead);
+        if (!header || header->id != chain.get_block_id_for_num(indexHead)) {
+            wlog("[ChainHandler] Block header index does not match the chain; rebuilding it");
+            indexHead = 0;
+        }
+    }
+    headerIndex.truncate(indexHead);
+
+    if (indexHead < chainHead) {
+        ilog("[ChainHandler] Indexing headers of blocks ${F} through ${L}", ("F", indexHead + 1)("L", chainHead));
+        for (auto num = indexHead + 1; num <= chainHead; ++num) {
+            auto block = chain.fetch_block_by_number(num);
+            if (!block.valid()) {
+                elog("[ChainHandler] Could not load block ${N} to index its header", ("N", num));
+                break;
+            }
+            headerIndex.append(*block);
+        }
+    }
 }
 
 bool ChainHandler::initializeContract(const std::string& name,
-                                      std::function<bool (chain::database&, uint8_t)> initFunction) {
+                                      std::function<bool (chain::database&, uint8_t)> initFunction,
+                                      const std::vector<std::pair<uint8_t, std::string>>& indexedFields,
+                                      const std::vector<std::string>& tableNames,
+                                      const std::vector<const TableReflection*>& tableReflections) {
     auto& primaryIndex = persistence.get_index_type<ContractRecordIndex>();
 
     // If this contract is one we've seen before, use the original space ID instead of a new one
@@ -111,84 +345,379 @@ bool ChainHandler::initializeContract(const std::string& name,
     }
 
     if (initFunction(chain, itr->contractObjectSpaceId())) {
-        loadedContracts.emplace(itr->contractObjectSpaceId(), name);
+        auto spaceId = itr->contractObjectSpaceId();
+        const auto& contract = contracts.add(chain, spaceId, name, tableNames, tableReflections);
+
+        for (const auto& [typeId, field] : indexedFields) {
+            auto key = std::make_tuple(spaceId, typeId, field);
+            if (fieldIndexes.count(key))
+                continue;
+            try {
+                auto* index = chain.add_secondary_index<FieldIndex>(spaceId, typeId);
+                const auto* table = contract.findTable(typeId);
+                index->setField(field, table == nullptr? nullptr : table->reflection);
+                index->backfill(chain.get_index(spaceId, typeId));
+                fieldIndexes.emplace(key, index);
+                ilog("[ChainHandler] Indexing contract ${N} table ${T} by field ${F}",
+                     ("N", name)("T", typeId)("F", field));
+            } catch (const fc::exception& e) {
+                elog("[ChainHandler] Failed to index contract ${N} table ${T} by field ${F}: ${E}",
+                     ("N", name)("T", typeId)("F", field)("E", e.to_detail_string()));
+            }
+        }
+
+        // Contracts loaded once the chain is open are journaled from now on; the rest are journaled when it opens
+        if (journal)
+            journalContract(spaceId, name);
         return true;
     }
     return false;
 }
 
+ChainHandler::QueryPage ChainHandler::findByField(uint8_t spaceId, uint8_t typeId, const std::string& field,
+                                                  const fc::variant& value, size_t limit,
+                                                  const std::optional<FieldIndex::Cursor>& after) const {
+    return findByFieldRange(spaceId, typeId, field, value, value, limit, after);
+}
+
+ChainHandler::QueryPage ChainHandler::findByFieldRange(uint8_t spaceId, uint8_t typeId, const std::string& field,
+                                                       const fc::variant& lower, const fc::variant& upper,
+                                                       size_t limit,
+                                                       const std::optional<FieldIndex::Cursor>& after) const {
+    auto itr = fieldIndexes.find(std::make_tuple(spaceId, typeId, field));
+    FC_ASSERT(itr != fieldIndexes.end(), "[ChainHandler] Table ${S}.${T} is not indexed by field ${F}",
+              ("S", spaceId)("T", typeId)("F", field));
+
+    auto page = itr->second->range(FieldIndex::keyOf(lower), FieldIndex::keyOf(upper), limit, after);
+    QueryPage result;
+    result.objects.reserve(page.ids.size());
+    for (const auto& id : page.ids)
+        result.objects.push_back(&chain.get_object(id));
+    result.next = std::move(page.next);
+    return result;
+}
+
+const ObjectDelta* ObjectEvent::delta() const {
+    if (before == nullptr)
+        return nullptr;
+    if (knownDelta != nullptr)
+        return knownDelta;
+    if (!computedDelta.has_value())
+        computedDelta = ObjectDelta::compute(before->pack(), current->pack());
+    return computedDelta.has_value()? &*computedDelta : nullptr;
+}
+
+const fc::variant_object& ObjectEvent::variant() const {
+    if (!cachedVariant.has_value()) {
+        if (before != nullptr && reflection != nullptr)
+            cachedVariant = fc::mutable_variant_object("id", current->id)
+                    ("changes", ObjectDelta::fieldChanges(*reflection, *before, *current,
+                                                          GRAPHENE_MAX_NESTED_OBJECTS));
+        else if (before != nullptr)
+            cachedVariant = fc::mutable_variant_object("id", current->id)
+                    ("changes", ObjectDelta::fieldChanges(before->to_variant().get_object(),
+                                                          current->to_variant().get_object()));
+        else
+            cachedVariant = current->to_variant().get_object();
+    }
+    return *cachedVariant;
+}
+
+class SubscriptionCounter::SubscriptionGuard {
+    std::weak_ptr<Subscriptions> subscriptions;
+    std::optional<uint8_t> typeId;
+
+    static void adjust(Subscriptions& s, std::optional<uint8_t> typeId, int delta) {
+        if (typeId.has_value()) {
+            s.byTable[*typeId] += delta;
+            s.tableSlots += delta;
+        } else {
+            s.allTables += delta;
+        }
+    }
+
+public:
+    SubscriptionGuard(const std::shared_ptr<Subscriptions>& subscriptions, std::optional<uint8_t> typeId)
+        : subscriptions(subscriptions), typeId(typeId) {
+        adjust(*subscriptions, typeId, 1);
+    }
+    ~SubscriptionGuard() {
+        if (auto s = subscriptions.lock()) {
+            adjust(*s, typeId, -1);
+            if (s->changed)
+                s->changed();
+        }
+    }
+};
+
+SubscriptionCounter::SubscriptionCounter() : subscriptions(std::make_shared<Subscriptions>()) {}
+
+std::shared_ptr<void> SubscriptionCounter::subscribe(std::optional<uint8_t> typeId) {
+    return std::make_shared<SubscriptionGuard>(subscriptions, typeId);
+}
+
+void SubscriptionCounter::notify() const {
+    if (subscriptions->changed)
+        subscriptions->changed();
+}
+
+sig::connection ObjectEventSignal::connect(Slot slot) {
+    auto guard = subscribe(std::nullopt);
+    auto connection = signal.connect([guard, slot = std::move(slot)](uint8_t typeId, const ObjectEvent& event) {
+        slot(typeId, event);
+    });
+    notify();
+    return connection;
+}
+
+sig::connection ObjectEventSignal::connect(uint8_t typeId, Slot slot) {
+    auto guard = subscribe(typeId);
+    auto connection = signal.connect([guard, typeId, slot = std::move(slot)](uint8_t type, const ObjectEvent& event) {
+        if (type == typeId)
+            slot(type, event);
+    });
+    notify();
+    return connection;
+}
+
+sig::connection ChangeSetSignal::connect(Slot slot) {
+    auto guard = subscribe(std::nullopt);
+    auto connection = signal.connect([guard, slot = std::move(slot)](const auto& changeSet) { slot(changeSet); });
+    notify();
+    return connection;
+}
+
+// Accumulates the objects touched in a contract's database between commits, and computes the net changes at commit
+class ChangeAccumulator {
+    // Objects touched since the last commit, with their state as of the last commit, or null if they didn't exist then
+    std::map<db::object_id_type, std::shared_ptr<const db::object>> touched;
+
+public:
+    // Record that an object was created
+    void created(const db::object& object) { touched.emplace(object.id, nullptr); }
+    // Record that an object is about to be modified or deleted
+    void touching(const db::object& object) {
+        if (touched.count(object.id) == 0)
+            touched.emplace(object.id, object.clone());
+    }
+
+    // Compare the touched objects against their current state to get the net changes, and begin accumulating anew
+    ContractChangeSet commit(const chain::database& db, uint64_t& noOpModifications) {
+        ContractChangeSet changeSet;
+        for (auto& [id, original] : touched) {
+            const db::object* current = db.find_object(id);
+            std::shared_ptr<const db::object> now;
+            if (current != nullptr)
+                now = current->clone();
+
+            using Operation = ContractChangeSet::Operation;
+            if (original == nullptr && now != nullptr)
+                changeSet.changes.push_back({Operation::Created, id.type(), id, std::move(now), nullptr});
+            else if (original != nullptr && now == nullptr)
+                changeSet.changes.push_back({Operation::Deleted, id.type(), id, std::move(original), nullptr});
+            else if (original != nullptr && original->pack() != now->pack())
+                changeSet.changes.push_back({Operation::Modified, id.type(), id, std::move(now), std::move(original)});
+            else if (original != nullptr)
+                ++noOpModifications;
+        }
+        touched.clear();
+        return changeSet;
+    }
+
+    bool empty() const { return touched.empty(); }
+    void clear() { touched.clear(); }
+};
+
+// Depth of object event dispatch currently in progress. While nonzero, the database is iterating its secondary indexes
+// so table monitors must not be attached or detached.
+static unsigned dispatchDepth = 0;
+
 struct TableMonitor : public db::secondary_index {
     uint8_t typeId = 0;
-    ObjectSignal* object_loaded_signal = nullptr;
-    ObjectSignal* object_created_signal = nullptr;
-    ObjectSignal* object_deleted_signal = nullptr;
-    ObjectSignal* object_modified_signal = nullptr;
-    std::optional<fc::variant_object> preModifiedObject;
+    // The reflection of the table, if the contract provided one
+    const TableReflection* reflection = nullptr;
+    ChainHandler::ContractDatabaseMonitor* owner = nullptr;
+    ChainHandler::ContractDatabaseMonitor::Counters* counters = nullptr;
+    // Accumulator for the owner's change sets, used while anybody is listening for them
+    ChangeAccumulator* changes = nullptr;
+    // A typed copy of the object about to be modified, so the modification event can show what it was
+    std::unique_ptr<db::object> preModifiedObject;
+
+    template<typename... Objects>
+    void emit(ObjectEventSignal& signal, const Objects&... objects) {
+        if (!signal.wants(typeId)) {
+            ++counters->skipped;
+            return;
+        }
+        struct DispatchScope {
+            DispatchScope() { ++dispatchDepth; }
+            ~DispatchScope() { --dispatchDepth; }
+        } scope;
+        ++counters->delivered;
+        ObjectEvent event(objects...);
+        event.setReflection(reflection);
+        signal(typeId, event);
+    }
 
     // secondary_index interface
     void object_loaded(const db::object& obj) override {
-        FC_ASSERT(object_loaded_signal != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
-        (*object_loaded_signal)(typeId, obj.to_variant().get_object());
+        FC_ASSERT(owner != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
+        emit(owner->object_loaded, obj);
     }
     void object_created(const db::object& obj) override {
-        FC_ASSERT(object_created_signal != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
-        (*object_created_signal)(typeId, obj.to_variant().get_object());
+        FC_ASSERT(owner != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
+        if (!owner->block_changes.empty())
+            changes->created(obj);
+        emit(owner->object_created, obj);
     }
     void object_removed(const db::object& obj) override {
-        FC_ASSERT(object_deleted_signal != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
-        (*object_deleted_signal)(typeId, obj.to_variant().get_object());
+        FC_ASSERT(owner != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
+        if (!owner->block_changes.empty())
+            changes->touching(obj);
+        emit(owner->object_deleted, obj);
     }
     void about_to_modify(const db::object& before) override {
-        preModifiedObject = before.to_variant().get_object();
+        FC_ASSERT(owner != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
+        if (!owner->block_changes.empty())
+            changes->touching(before);
+        // Only copy the object if somebody will see the modification
+        if (owner->object_modified.wants(typeId))
+            preModifiedObject = before.clone();
     }
     void object_modified(const db::object& after) override {
-        FC_ASSERT(object_modified_signal != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
-        auto object = after.to_variant().get_object();
-        if (preModifiedObject.has_value()) {
-            auto change = fc::mutable_variant_object("from", std::move(*preModifiedObject))("to", std::move(object));
-            (*object_modified_signal)(typeId, std::move(change));
+        FC_ASSERT(owner != nullptr, "[ChainHandler] Table Monitor used before being initialized!");
+        if (!owner->object_modified.wants(typeId)) {
+            ++counters->skipped;
+            preModifiedObject.reset();
+        } else if (preModifiedObject) {
+            // Compare the packed states, rather than variants, to find out what changed, if anything
+            auto started = fc::time_point::now();
+            auto packedAfter = after.pack();
+            auto delta = ObjectDelta::compute(preModifiedObject->pack(), packedAfter);
+            counters->deltaMicroseconds += (fc::time_point::now() - started).count();
+
+            if (delta.has_value()) {
+                ++counters->modifications;
+                counters->deltaBytes += delta->packedSize();
+                counters->objectBytes += packedAfter.size();
+                emit(owner->object_modified, *preModifiedObject, after, *delta);
+            } else {
+                ++counters->noOpModifications;
+            }
             preModifiedObject.reset();
         } else {
             elog("[ChainHandler] Object notified of post-modified object without having been notified of pre-modified"
                  " object! Post-modified object: ${O}",
-                 ("O", object));
+                 ("O", after.to_variant()));
         }
     }
 };
 
+// Monitors a contract's tables on behalf of the slots connected to its signals. A table is only monitored while at
+// least one slot listens to it; monitors are attached and detached as slots connect and disconnect. If that happens
+// while events are being dispatched, the change is deferred until the next block is applied.
+//
+// While anybody listens for change sets, every table is monitored, and the objects touched by each block accumulate
+// until the block is applied, when the block's net changes are delivered.
 class MultiTableMonitor : public ChainHandler::ContractDatabaseMonitor {
-    db::object_database& db;
-    std::vector<TableMonitor*> monitors;
+    chain::database& db;
+    const ContractRegistry& contracts;
+    std::map<uint8_t, TableMonitor*> monitors;
+    ChangeAccumulator changes;
+    sig::scoped_connection appliedBlockConnection;
+    bool refreshPending = false;
 
-public:
-    MultiTableMonitor(const std::string& contractName, const uint8_t spaceId, db::object_database& db)
-        : ContractDatabaseMonitor(contractName, spaceId), db(db) {
+    std::array<SubscriptionCounter*, 5> signals() {
+        return {&object_loaded, &object_created, &object_deleted, &object_modified, &block_changes};
+    }
+    bool wantsTable(uint8_t typeId) {
+        auto all = signals();
+        return std::any_of(all.begin(), all.end(), [typeId](const SubscriptionCounter* s) { return s->wants(typeId); });
+    }
 
-        // Find each table in the object space and attach a monitor to it
-        db.inspect_all_indexes(spaceId, [&db, this](const db::index& index) {
-            try {
-                auto* monitor = db.add_secondary_index<TableMonitor>(index.object_space_id(), index.object_type_id());
-                monitor->typeId = index.object_type_id();
-                monitor->object_loaded_signal = &object_loaded;
-                monitor->object_created_signal = &object_created;
-                monitor->object_deleted_signal = &object_deleted;
-                monitor->object_modified_signal = &object_modified;
-                monitors.emplace_back(monitor);
-            } catch (fc::exception_ptr e) {
-                elog("[ChainHandler] Failed to monitor table ${S}.${T} due to error. Proceeding with other tables."
-                     " Error: ${E}", ("S", index.object_space_id())("T", index.object_type_id())("E", *e));
-            }
+    void blockApplied(const chain::signed_block& block) {
+        if (refreshPending)
+            refresh();
+        if (block_changes.empty() || changes.empty())
+            return;
+
+        auto changeSet = std::make_shared<ContractChangeSet>(changes.commit(db, counters.noOpModifications));
+        if (changeSet->changes.empty())
+            return;
+        changeSet->spaceId = spaceId;
+        changeSet->blockNum = block.block_num();
+        changeSet->blockId = block.id();
+        ++counters.changeSets;
+        block_changes(changeSet);
+    }
+
+    void attach(const db::index& index) {
+        try {
+            auto* monitor = db.add_secondary_index<TableMonitor>(index.object_space_id(), index.object_type_id());
+            monitor->typeId = index.object_type_id();
+            if (const auto* contract = contracts.find(spaceId))
+                if (const auto* table = contract->findTable(monitor->typeId))
+                    monitor->reflection = table->reflection;
+            monitor->owner = this;
+            monitor->counters = &counters;
+            monitor->changes = &changes;
+            monitors.emplace(monitor->typeId, monitor);
+            ++counters.attached;
+        } catch (fc::exception_ptr e) {
+            elog("[ChainHandler] Failed to monitor table ${S}.${T} due to error. Proceeding with other tables."
+                 " Error: ${E}", ("S", index.object_space_id())("T", index.object_type_id())("E", *e));
+        }
+    }
+    void detach(uint8_t typeId) {
+        auto itr = monitors.find(typeId);
+        db.delete_secondary_index(spaceId, typeId, *itr->second);
+        monitors.erase(itr);
+        ++counters.detached;
+    }
+
+    // Attach monitors to tables somebody is listening to, and detach them from tables nobody is listening to
+    void refresh() {
+        if (dispatchDepth > 0) {
+            refreshPending = true;
+            return;
+        }
+        refreshPending = false;
+        if (block_changes.empty())
+            changes.clear();
+
+        db.inspect_all_indexes(spaceId, [this](const db::index& index) {
+            auto typeId = index.object_type_id();
+            bool monitored = monitors.count(typeId) > 0;
+            bool wanted = wantsTable(typeId);
+            if (wanted && !monitored)
+                attach(index);
+            else if (!wanted && monitored)
+                detach(typeId);
         });
+        counters.monitoredTables = monitors.size();
+    }
+
+public:
+    MultiTableMonitor(const std::string& contractName, const uint8_t spaceId, chain::database& db,
+                      const ContractRegistry& contracts)
+        : ContractDatabaseMonitor(contractName, spaceId), db(db), contracts(contracts) {
+        for (auto* signal : signals())
+            signal->onSubscriptionsChanged([this] { refresh(); });
+        appliedBlockConnection = db.applied_block.connect([this](const chain::signed_block& b) { blockApplied(b); });
     }
     virtual ~MultiTableMonitor() {
+        // The signals outlive this destructor, and disconnect their slots when they go; don't hear about it
+        for (auto* signal : signals())
+            signal->onSubscriptionsChanged({});
+
         // Destroy the table monitors
-        for (const TableMonitor* monitor : monitors)
-            db.delete_secondary_index(spaceId, monitor->typeId, *monitor);
+        for (const auto& [typeId, monitor] : monitors)
+            db.delete_secondary_index(spaceId, typeId, *monitor);
         monitors.clear();
     }
 };
 
 std::unique_ptr<ChainHandler::ContractDatabaseMonitor> ChainHandler::observeContract(uint8_t spaceId,
                                                                                      const std::string& name) {
-    return std::make_unique<MultiTableMonitor>(name, spaceId, chain);
+    return std::make_unique<MultiTableMonitor>(name, spaceId, chain, contracts);
 }
@@ -1,11 +1,23 @@
 #pragma once
 
+#include "BlockHeaderIndex.hpp"
+#include "ObjectDelta.hpp"
+#include "FieldIndex.hpp"
+#include "ContractSnapshotCursor.hpp"
+#include "ContractRegistry.hpp"
+#include "StateCheckpointer.hpp"
+
 #include <graphene/chain/database.hpp>
 
 #include <fc/reflect/variant.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <boost/signals2/signal.hpp>
+#include <array>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <tuple>
 
 namespace chain = graphene::chain;
 namespace protocol = graphene::protocol;
@@ -13,9 +25,141 @@ namespace db = graphene::db;
 
 namespace sig = boost::signals2;
 
-using ObjectSignal = sig::signal<void(uint8_t, fc::variant_object)>;
+// A notification of activity on an object in a contract's database.
+//
+// The event refers to the object itself rather than a copy of it, so it is cheap to create. Subscribers that want the
+// object's contents as a variant can get them from variant(), which builds the variant the first time it is called and
+// reuses it for any subscribers thereafter. For modifications, delta() describes the change compactly in binary, and
+// the variant lists only the changed fields, found by comparing the fields directly if the table is reflected. The
+// references within the event are only valid while the signal carrying it is being emitted, so subscribers must not
+// retain them.
+class ObjectEvent {
+    const db::object* current = nullptr;
+    const db::object* before = nullptr;
+    const ObjectDelta* knownDelta = nullptr;
+    const TableReflection* reflection = nullptr;
+    mutable std::optional<ObjectDelta> computedDelta;
+    mutable std::optional<fc::variant_object> cachedVariant;
+
+public:
+    // An event concerning a single object: a load, creation, or deletion
+    explicit ObjectEvent(const db::object& object) : current(&object) {}
+    // An event concerning a modification: before is the object prior to the modification; after is the object now
+    ObjectEvent(const db::object& before, const db::object& after) : current(&after), before(&before) {}
+    // A modification event where the delta between the object states is already known
+    ObjectEvent(const db::object& before, const db::object& after, const ObjectDelta& delta)
+        : current(&after), before(&before), knownDelta(&delta) {}
+
+    // Set the reflection of the object's table, if it has one
+    void setReflection(const TableReflection* tableReflection) { reflection = tableReflection; }
+
+    // Get the object. For modifications, this is the modified object.
+    const db::object& object() const { return *current; }
+    // For modifications, get the object as it was prior to modification. Otherwise, returns null.
+    const db::object* previous() const { return before; }
+    bool isModification() const { return before != nullptr; }
+    // For modifications, get the delta from the prior state to the current one. Otherwise, or if the modification
+    // changed nothing, returns null.
+    const ObjectDelta* delta() const;
+
+    // Get the object as a variant. For modifications, this is like {"id": <id>, "changes": <changed fields>}, where
+    // the changed fields are like {"field": {"from": <value>, "to": <value>}}
+    const fc::variant_object& variant() const;
+};
+
+using ObjectSignal = sig::signal<void(uint8_t, const ObjectEvent&)>;
+
+// Keeps count of the slots connected to a signal, in total and per table, so the monitor emitting the signal can skip
+// the work of producing events nobody is listening for. Disconnecting a slot releases its subscription.
+class SubscriptionCounter {
+public:
+    // Check whether any slot is listening to the table with the given type ID
+    bool wants(uint8_t typeId) const { return subscriptions->allTables > 0 || subscriptions->byTable[typeId] > 0; }
+    bool empty() const { return subscriptions->allTables == 0 && subscriptions->tableSlots == 0; }
+
+    // Set a callback to be invoked whenever a slot connects or disconnects
+    void onSubscriptionsChanged(std::function<void()> callback) { subscriptions->changed = std::move(callback); }
+
+protected:
+    SubscriptionCounter();
+
+    // Record a subscription to all tables, or to the table with the given type ID. The returned guard must be held by
+    // the connected slot; when the slot is destroyed, the subscription is released.
+    std::shared_ptr<void> subscribe(std::optional<uint8_t> typeId);
+    // Invoke the subscriptions changed callback, if any
+    void notify() const;
+
+private:
+    struct Subscriptions {
+        uint32_t allTables = 0;
+        uint32_t tableSlots = 0;
+        std::array<uint32_t, 256> byTable = {};
+        std::function<void()> changed;
+    };
+    class SubscriptionGuard;
+
+    // Shared with the guards held by connected slots, which may outlive the signal briefly while it's destroyed
+    std::shared_ptr<Subscriptions> subscriptions;
+};
+
+// An ObjectSignal which counts its subscribers. Slots may listen to all of a contract's tables, or to a single table by
+// type ID.
+class ObjectEventSignal : public SubscriptionCounter {
+public:
+    using Slot = std::function<void(uint8_t, const ObjectEvent&)>;
+
+    // Connect a slot to events from all tables
+    sig::connection connect(Slot slot);
+    // Connect a slot to events from the table with the given type ID only
+    sig::connection connect(uint8_t typeId, Slot slot);
+
+    void operator()(uint8_t typeId, const ObjectEvent& event) const { signal(typeId, event); }
+
+private:
+    ObjectSignal signal;
+};
+
+// The net changes a committed block made to a contract's database.
+//
+// Changes are reported by their effect over the whole block: an object modified several times appears once, with its
+// state before and after the block; an object created and deleted within the block doesn't appear at all; and changes
+// undone by a failed transaction, or modifications that left an object as it was, are not reported. Change sets are
+// immutable once delivered, and may be retained by subscribers.
+struct ContractChangeSet {
+    enum class Operation : uint8_t { Created, Modified, Deleted };
+
+    struct Change {
+        Operation operation;
+        uint8_t typeId = 0;
+        db::object_id_type id;
+        // The object after the block; for deletions, the object prior to the block
+        std::shared_ptr<const db::object> object;
+        // For modifications, the object prior to the block; otherwise null
+        std::shared_ptr<const db::object> previous;
+    };
+
+    uint8_t spaceId = 0;
+    uint32_t blockNum = 0;
+    protocol::block_id_type blockId;
+    // The changes, in order of object ID
+    std::vector<Change> changes;
+};
+
+// A signal carrying per-block change sets, which counts its subscribers
+class ChangeSetSignal : public SubscriptionCounter {
+public:
+    using Slot = std::function<void(const std::shared_ptr<const ContractChangeSet>&)>;
+
+    sig::connection connect(Slot slot);
+
+    void operator()(const std::shared_ptr<const ContractChangeSet>& changeSet) const { signal(changeSet); }
+
+private:
+    sig::signal<void(const std::shared_ptr<const ContractChangeSet>&)> signal;
+};
 
 class MultiTableMonitor;
+class ContractJournal;
 
 // The ChainHandler is responsible for managing the blockchain and contract databases.
 class ChainHandler {
@@ -26,19 +170,53 @@ class ChainHandler {
     fc::path basePath = fc::home_path() / ".config/PeerplaysContractNode";
     fc::path chainPath() const { return basePath / "Chain"; }
     fc::path persistencePath() const { return basePath / "NodePersistence"; }
+    fc::path headerIndexPath() const { return basePath / "BlockHeaderIndex"; }
+    fc::path journalPath() const { return basePath / "ContractJournal"; }
+    fc::path snapshotPath() const { return basePath / "snapshot.bin"; }
+    fc::path genesisCachePath() const { return basePath / "genesis.cache"; }
+    fc::path checkpointsPath() const { return basePath / "Checkpoints"; }
+    // Holds the blocks after a recovered checkpoint until they've all been applied again
+    fc::path recoveryBlocksPath() const { return basePath / "RecoveryBlocks"; }
+    // Exists while the databases are open, so if it's there when we start, we didn't shut down cleanly
+    fc::path dirtyMarkerPath() const { return basePath / "dirty"; }
 
     // The blockchain/database
     chain::database chain;
     // The persistence database for the node's off-chain settings
     db::object_database persistence;
+    // Index of the headers of the blocks in the chain
+    BlockHeaderIndex headerIndex;
+    // Journal of the changes blocks make to contract databases, if enabled. It's off unless asked for, as it keeps
+    // every table of every contract monitored.
+    bool journalEnabled = false;
+    std::unique_ptr<ContractJournal> journal;
 
     // Whether the database is open or not
     bool isOpen = false;
+    // Chain ID of the snapshot the databases were restored from, if they were, to check the restored chain against
+    std::optional<protocol::chain_id_type> snapshotChainId;
+    // Periodic checkpoints of the databases, to recover from an unclean shutdown
+    bool checkpointsEnabled = true;
+    StateCheckpointer checkpointer;
 
-    // Map of contract space ID to name
-    std::map<uint8_t, std::string> loadedContracts;
+    // The contracts currently loaded into the blockchain, and their tables
+    ContractRegistry contracts;
     // Map of object space ID and type ID to an observer of that table
     std::map<std::pair<uint8_t, uint8_t>, MultiTableMonitor*> observers;
+    // Map of object space ID, type ID, and field name to an index of that table by that field
+    std::map<std::tuple<uint8_t, uint8_t, std::string>, FieldIndex*> fieldIndexes;
+
+    // Bring the header index up to date with the chain, rebuilding it if necessary
+    void syncHeaderIndex();
+    // Roll the journal back to the newest block it shares with the chain
+    void syncJournal();
+    // Record a contract's changes in the journal
+    void journalContract(uint8_t spaceId, const std::string& name);
+    // Restore the databases from the newest usable checkpoint, after an unclean shutdown
+    void recoverFromCheckpoint();
+    // Apply the blocks held in the recovery store after the chain's head, removing the store once all are applied.
+    // Throws, keeping the store, if any fails.
+    void applyRecoveryBlocks();
 
 public:
     // The lowest object space in the blockchain database that we assign to contracts
@@ -55,15 +233,50 @@ public:
         const uint8_t spaceId = 0;
 
         // Notification that an object was loaded from disk; passes type ID and loaded object
-        ObjectSignal object_loaded;
+        ObjectEventSignal object_loaded;
         // Notification that a new object was created; passes type ID and created object
-        ObjectSignal object_created;
+        ObjectEventSignal object_created;
         // Notification that an object was deleted; passes type ID and object value prior to deletion
-        ObjectSignal object_deleted;
-        // Notification that on object was updated; passes type ID and object like {"from": <object>, "to": <object>}
-        ObjectSignal object_modified;
+        ObjectEventSignal object_deleted;
+        // Notification that on object was updated; passes type ID and an event with the object before and after
+        ObjectEventSignal object_modified;
+        // Notification that a block was applied, with the net changes it made to the contract's database. Only sent
+        // for blocks which changed something.
+        ChangeSetSignal block_changes;
+
+        struct Counters {
+            // Events delivered to at least one slot
+            uint64_t delivered = 0;
+            // Events observed on a monitored table, but not produced because no slot was listening for them
+            uint64_t skipped = 0;
+            // Change sets delivered
+            uint64_t changeSets = 0;
+            // Modifications which left an object as it was, and so were not reported
+            uint64_t noOpModifications = 0;
+            // Modifications reported with a delta; the packed size of those deltas, and of the modified objects, in
+            // total; and the total time spent computing the deltas, including packing the objects
+            uint64_t modifications = 0;
+            uint64_t deltaBytes = 0;
+            uint64_t objectBytes = 0;
+            uint64_t deltaMicroseconds = 0;
+            // Tables currently monitored; tables nobody listens to are not monitored and cost nothing
+            uint64_t monitoredTables = 0;
+            // Number of times a table monitor was attached or detached as slots connected and disconnected
+            uint64_t attached = 0;
+            uint64_t detached = 0;
+        };
+        const Counters& getCounters() const { return counters; }
+
+    protected:
+        Counters counters;
     };
 
+private:
+    // Monitors feeding the journal, one per loaded contract
+    std::vector<std::unique_ptr<ContractDatabaseMonitor>> journalMonitors;
+
+public:
+
     ChainHandler();
     ~ChainHandler();
 
@@ -74,31 +287,70 @@ public:
         basePath = newPath;
     }
     chain::database& getChain() { return chain; }
+    // Get the index of block headers, which answers header queries without loading blocks
+    const BlockHeaderIndex& getHeaderIndex() const { return headerIndex; }
+    // Enable or disable the journal of contract database changes, which is kept under the config path
+    void setJournalEnabled(bool enabled) {
+        FC_ASSERT(!isOpen, "Cannot enable or disable the journal after the databases are opened");
+        journalEnabled = enabled;
+    }
+    // Enable or disable periodic checkpoints of the databases, which are kept under the config path
+    void setCheckpointsEnabled(bool enabled) {
+        FC_ASSERT(!isOpen, "Cannot enable or disable checkpoints after the databases are opened");
+        checkpointsEnabled = enabled;
+    }
+    // Get the journal of contract database changes, or null if it's disabled
+    const ContractJournal* getJournal() const { return journal.get(); }
 
     // Initialize the databases
     void initialize();
     // Open the databases
     void open();
 
+    // Get the path snapshots are exported to
+    fc::path getSnapshotPath() const { return snapshotPath(); }
+    // Check whether the config path has a chain database in it already
+    bool hasChainState() const { return fc::exists(chainPath() / "object_database"); }
+    // Export a snapshot of the databases at the current head block. The chain must be open, and no blocks may be
+    // applied until this returns: it waits on other threads while copying, letting other tasks on this thread run.
+    void exportSnapshot(const fc::path& snapshotFile);
+    // Restore the databases from a snapshot. Must be called before the databases are initialized, and only when there
+    // is no chain state yet. The restored chain begins at the snapshot's head block; earlier blocks are not available.
+    void importSnapshot(const fc::path& snapshotFile);
+
     // Get a map of database space IDs to contract name for all contracts currently loaded into the blockchain
-    const std::map<uint8_t, std::string>& getLoadedContracts() const { return loadedContracts; }
+    const std::map<uint8_t, std::string>& getLoadedContracts() const { return contracts.names(); }
+    // Get the registry of loaded contracts, to look them and their tables up by name or ID
+    const ContractRegistry& getContractRegistry() const { return contracts; }
     // Get the space ID of the contract with the given name
-    uint8_t getSpaceId(const std::string& contractName) const {
-         auto itr = std::find_if(loadedContracts.cbegin(), loadedContracts.cend(),
-                                [&contractName](const auto& pair) { return pair.second == contractName; });
-        FC_ASSERT(itr != loadedContracts.cend(), "[ChainHandler] Could not find contract named ${N}",
-                  ("N", contractName));
-        return itr->first;
-    }
+    uint8_t getSpaceId(const std::string& contractName) const { return contracts.get(contractName).spaceId; }
 
     // Load a contract into the blockchain, assigning it a space ID. Returns the result of the contract initializer.
-    bool initializeContract(const std::string& name, std::function<bool(chain::database&, uint8_t)> initFunction);
+    // If the contract declares indexed fields, its tables are indexed by those fields. Table names, if given, name the
+    // contract's tables in type ID order. Table reflections, if given, let the node work with the reflected tables'
+    // objects field by field.
+    bool initializeContract(const std::string& name, std::function<bool(chain::database&, uint8_t)> initFunction,
+                            const std::vector<std::pair<uint8_t, std::string>>& indexedFields = {},
+                            const std::vector<std::string>& tableNames = {},
+                            const std::vector<const TableReflection*>& tableReflections = {});
+
+    // A page of objects found by a query, and a cursor to pass to the same query to get the next page, if any
+    struct QueryPage {
+        std::vector<const db::object*> objects;
+        std::optional<FieldIndex::Cursor> next;
+    };
+    // Find the objects in a contract table whose indexed field equals the value. The field must be indexed.
+    QueryPage findByField(uint8_t spaceId, uint8_t typeId, const std::string& field, const fc::variant& value,
+                          size_t limit, const std::optional<FieldIndex::Cursor>& after = {}) const;
+    // Find the objects in a contract table whose indexed field is between the bounds, inclusive
+    QueryPage findByFieldRange(uint8_t spaceId, uint8_t typeId, const std::string& field, const fc::variant& lower,
+                               const fc::variant& upper, size_t limit,
+                               const std::optional<FieldIndex::Cursor>& after = {}) const;
 
     // Get signals notifying of a contract's database activity
     std::unique_ptr<ContractDatabaseMonitor> observeContract(uint8_t spaceId) {
-        auto itr = loadedContracts.find(spaceId);
-        if (itr != loadedContracts.end())
-            return observeContract(spaceId, itr->second);
+        if (const auto* contract = contracts.find(spaceId))
+            return observeContract(spaceId, contract->name);
         return observeContract(spaceId, "Unknown Contract");
     }
     std::unique_ptr<ContractDatabaseMonitor> observeContract(const std::string& name) {
@@ -120,4 +372,19 @@ public:
     void inspectContractDatabase(const std::string& name, F&& f) {
         inspectContractDatabase(getSpaceId(name), std::forward<F>(f));
     }
+
+    // Get a cursor to walk a contract's database in chunks, from the start or from where an earlier cursor left off
+    ContractSnapshotCursor snapshotContract(uint8_t spaceId, ContractSnapshotCursor::Position from = {}) const {
+        return ContractSnapshotCursor(chain, spaceId, from);
+    }
+    // Visit all objects in a contract's database, in order, chunkSize objects at a time, yielding to the other tasks on
+    // this fc thread between chunks. F is a functor taking a const db::object&. Unlike inspectContractDatabase, this
+    // doesn't convert the objects to variants, and doesn't hold up block application while it runs. See
+    // ContractSnapshotCursor for how the walk sees blocks applied meanwhile.
+    template<typename F>
+    void streamContractDatabase(uint8_t spaceId, F&& f, size_t chunkSize = 1000) const {
+        auto cursor = snapshotContract(spaceId);
+        while (cursor.next(chunkSize, f))
+            fc::yield();
+    }
 };
@@ -0,0 +1,332 @@
+#include "ContractJournal.hpp"
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace BIP = boost::interprocess;
+
+fc::path ContractJournalFormat::segmentPath(const fc::path& directory, uint32_t firstBlockNum) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%010u.journal", firstBlockNum);
+    return directory / name;
+}
+
+std::map<uint32_t, fc::path> ContractJournalFormat::listSegments(const fc::path& directory) {
+    std::map<uint32_t, fc::path> segments;
+    if (!fc::is_directory(directory))
+        return segments;
+
+    for (fc::directory_iterator itr(directory); itr != fc::directory_iterator(); ++itr) {
+        unsigned firstBlockNum = 0;
+        char suffix[16] = {};
+        auto name = itr->filename().string();
+        if (std::sscanf(name.c_str(), "segment-%10u.%15s", &firstBlockNum, suffix) == 2 &&
+            std::strcmp(suffix, "journal") == 0)
+            segments.emplace(firstBlockNum, *itr);
+    }
+    return segments;
+}
+
+ContractJournal::ContractJournal() : ContractJournal(Options()) {}
+
+void ContractJournal::open(const fc::path& directory) {
+    close();
+    fc::create_directories(directory);
+    this->directory = directory;
+    segments = Format::listSegments(directory);
+    lastSync = std::chrono::steady_clock::now();
+    if (segments.empty())
+        return;
+
+    mapCurrent();
+    auto& header = segmentHeader();
+    if (header.magic != Format::MAGIC || header.version != Format::VERSION || header.used < sizeof(header) ||
+        header.used > region->get_size()) {
+        wlog("[ContractJournal] Segment ${P} is not in a format we recognize; discarding it",
+             ("P", segments.rbegin()->second));
+        unmapCurrent();
+        fc::remove(segments.rbegin()->second);
+        segments.erase(std::prev(segments.end()));
+        if (!segments.empty())
+            mapCurrent();
+    }
+    if (!region)
+        return;
+
+    // Recall the IDs of the blocks in the newest segment, to recognize fork switches
+    auto& segment = segmentHeader();
+    const char* data = segmentData();
+    uint64_t offset = sizeof(segment);
+    uint32_t lastBlockNum = segment.firstBlockNum;
+    while (offset < segment.used && frameFits(offset, segment.used)) {
+        const auto* frame = reinterpret_cast<const Format::FrameHeader*>(data + offset);
+        block_id_type id;
+        std::memcpy(id.data(), frame->blockId, sizeof(frame->blockId));
+        recentBlocks[frame->blockNum] = id;
+        lastBlockNum = frame->blockNum;
+        offset += frame->size;
+    }
+    if (offset != segment.used) {
+        // The node stopped before the segment's tail reached the disk; keep what's intact and drop the rest
+        wlog("[ContractJournal] Segment ${P} has a damaged frame at offset ${O}; truncating it after block ${N}",
+             ("P", segments.rbegin()->second)("O", offset)("N", lastBlockNum));
+        segment.used = offset;
+        segment.lastBlockNum = lastBlockNum;
+        region->flush(0, sizeof(segment), false);
+    }
+    syncedTo = segment.used;
+}
+
+void ContractJournal::close() {
+    if (region)
+        sync();
+    unmapCurrent();
+    segments.clear();
+    recentBlocks.clear();
+    directory = fc::path();
+}
+
+void ContractJournal::mapCurrent(size_t minimumSize) {
+    unmapCurrent();
+    const auto& path = segments.rbegin()->second;
+    auto size = std::max({options.segmentSize, minimumSize, sizeof(Format::SegmentHeader)});
+    if (fc::file_size(path) < size)
+        fc::resize_file(path, size);
+
+    mapping = std::make_unique<BIP::file_mapping>(path.string().c_str(), BIP::read_write);
+    region = std::make_unique<BIP::mapped_region>(*mapping, BIP::read_write);
+}
+
+void ContractJournal::unmapCurrent() {
+    region.reset();
+    mapping.reset();
+}
+
+void ContractJournal::reserve(size_t frameSize, uint32_t blockNum) {
+    if (region && segmentHeader().used + frameSize <= region->get_size())
+        return;
+
+    // Finish the current segment, trimming its unused space, and begin a new one
+    if (region) {
+        auto used = segmentHeader().used;
+        sync();
+        unmapCurrent();
+        fc::resize_file(segments.rbegin()->second, used);
+    }
+
+    auto path = Format::segmentPath(directory, blockNum);
+    std::ofstream(path.string(), std::ios::binary | std::ios::trunc).close();
+    segments[blockNum] = path;
+    mapCurrent(sizeof(Format::SegmentHeader) + frameSize);
+
+    auto& header = segmentHeader();
+    std::memset(&header, 0, sizeof(header));
+    header.magic = Format::MAGIC;
+    header.version = Format::VERSION;
+    header.firstBlockNum = blockNum;
+    header.lastBlockNum = blockNum;
+    header.used = sizeof(header);
+    syncedTo = 0;
+}
+
+void ContractJournal::record(const ContractChangeSet& changeSet) {
+    FC_ASSERT(isOpen(), "[ContractJournal] Journal used before being opened!");
+    rollbackIfForked(changeSet.blockNum, changeSet.blockId);
+
+    // Pack the objects first, to know the frame size
+    std::vector<std::vector<char>> packed;
+    packed.reserve(changeSet.changes.size());
+    size_t frameSize = sizeof(Format::FrameHeader);
+    for (const auto& change : changeSet.changes) {
+        packed.emplace_back(change.object->pack());
+        frameSize += sizeof(Format::ChangeHeader) + Format::padded(packed.back().size());
+    }
+    reserve(frameSize, changeSet.blockNum);
+
+    auto& segment = segmentHeader();
+    char* position = segmentData() + segment.used;
+    std::memset(position, 0, frameSize);
+
+    auto* frame = reinterpret_cast<Format::FrameHeader*>(position);
+    frame->size = frameSize;
+    frame->blockNum = changeSet.blockNum;
+    frame->changeCount = changeSet.changes.size();
+    frame->spaceId = changeSet.spaceId;
+    std::memcpy(frame->blockId, changeSet.blockId.data(), sizeof(frame->blockId));
+    position += sizeof(*frame);
+
+    for (size_t i = 0; i < changeSet.changes.size(); ++i) {
+        const auto& change = changeSet.changes[i];
+        auto* header = reinterpret_cast<Format::ChangeHeader*>(position);
+        header->instance = change.id.instance();
+        header->dataSize = packed[i].size();
+        header->typeId = change.typeId;
+        header->operation = static_cast<uint8_t>(change.operation);
+        position += sizeof(*header);
+        std::memcpy(position, packed[i].data(), packed[i].size());
+        position += Format::padded(packed[i].size());
+    }
+
+    // Publish the frame only once it's complete
+    segment.lastBlockNum = changeSet.blockNum;
+    segment.used += frameSize;
+
+    if (recentBlocks.count(changeSet.blockNum) == 0)
+        ++unsyncedBlocks;
+    recentBlocks[changeSet.blockNum] = changeSet.blockId;
+    while (recentBlocks.size() > RECENT_BLOCKS)
+        recentBlocks.erase(recentBlocks.begin());
+    syncIfDue();
+}
+
+void ContractJournal::blockApplied(uint32_t blockNum, const block_id_type& blockId) {
+    if (!isOpen())
+        return;
+    rollbackIfForked(blockNum, blockId);
+    syncIfDue();
+}
+
+void ContractJournal::rollbackIfForked(uint32_t blockNum, const block_id_type& blockId) {
+    if (recentBlocks.empty() || recentBlocks.rbegin()->first < blockNum)
+        return;
+
+    // We've journaled this block number or later already. If it was this very block, we've popped back to it and are
+    // applying the blocks after it again; otherwise, it's been replaced by another fork.
+    auto itr = recentBlocks.find(blockNum);
+    if (itr != recentBlocks.end() && itr->second == blockId) {
+        if (recentBlocks.rbegin()->first > blockNum)
+            truncate(blockNum);
+    } else {
+        truncate(blockNum - 1);
+    }
+}
+
+void ContractJournal::truncate(uint32_t headBlockNum) {
+    if (!isOpen() || this->headBlockNum() <= headBlockNum)
+        return;
+    ilog("[ContractJournal] Rolling journal back to block ${N}", ("N", headBlockNum));
+
+    // Drop whole segments which begin after the new head
+    while (!segments.empty() && segments.rbegin()->first > headBlockNum) {
+        unmapCurrent();
+        fc::remove(segments.rbegin()->second);
+        segments.erase(std::prev(segments.end()));
+    }
+    recentBlocks.erase(recentBlocks.upper_bound(headBlockNum), recentBlocks.end());
+    if (segments.empty())
+        return;
+
+    // Cut the newest remaining segment after the new head's last frame
+    if (!region)
+        mapCurrent();
+    auto& segment = segmentHeader();
+    const char* data = segmentData();
+    uint64_t cut = sizeof(segment);
+    uint32_t lastBlockNum = segment.firstBlockNum;
+    while (cut < segment.used) {
+        if (!frameFits(cut, segment.used)) {
+            wlog("[ContractJournal] Segment ${P} has a damaged frame at offset ${O}; truncating it after block ${N}",
+                 ("P", segments.rbegin()->second)("O", cut)("N", lastBlockNum));
+            break;
+        }
+        const auto* frame = reinterpret_cast<const Format::FrameHeader*>(data + cut);
+        if (frame->blockNum > headBlockNum)
+            break;
+        lastBlockNum = frame->blockNum;
+        cut += frame->size;
+    }
+    segment.used = cut;
+    segment.lastBlockNum = lastBlockNum;
+    syncedTo = std::min(syncedTo, cut);
+    sync();
+}
+
+void ContractJournal::sync() {
+    if (!region)
+        return;
+
+    // Flush the frames before the header which publishes them, so the header never covers frames not yet on disk
+    auto used = segmentHeader().used;
+    if (used > syncedTo)
+        region->flush(syncedTo, used - syncedTo, false);
+    region->flush(0, sizeof(Format::SegmentHeader), false);
+    syncedTo = used;
+    unsyncedBlocks = 0;
+    lastSync = std::chrono::steady_clock::now();
+}
+
+void ContractJournal::syncIfDue() {
+    if (unsyncedBlocks >= options.syncBlocks ||
+        (unsyncedBlocks > 0 && std::chrono::steady_clock::now() - lastSync >= options.syncInterval))
+        sync();
+}
+
+bool ContractJournal::frameFits(uint64_t offset, uint64_t used) const {
+    if (offset + sizeof(Format::FrameHeader) > used)
+        return false;
+    const auto* frame = reinterpret_cast<const Format::FrameHeader*>(segmentData() + offset);
+    return frame->size >= sizeof(*frame) && offset + frame->size <= used;
+}
+
+uint32_t ContractJournal::headBlockNum() const {
+    return region? segmentHeader().lastBlockNum : 0;
+}
+
+std::optional<ContractJournal::block_id_type> ContractJournal::blockId(uint32_t blockNum) const {
+    auto itr = recentBlocks.find(blockNum);
+    if (itr == recentBlocks.end())
+        return {};
+    return itr->second;
+}
+
+ContractJournalReader::block_id_type ContractJournalReader::Frame::blockId() const {
+    block_id_type id;
+    std::memcpy(id.data(), header->blockId, sizeof(header->blockId));
+    return id;
+}
+
+size_t ContractJournalReader::scan(uint32_t fromBlockNum, const std::function<bool(const Frame&)>& f) const {
+    using Format = ContractJournalFormat;
+    auto segments = Format::listSegments(directory);
+    if (segments.empty())
+        return 0;
+
+    // Begin with the last segment starting at or before the requested block; earlier ones can't hold it
+    auto itr = segments.upper_bound(fromBlockNum);
+    if (itr != segments.begin())
+        --itr;
+
+    size_t scanned = 0;
+    for (; itr != segments.end(); ++itr) {
+        BIP::file_mapping mapping(itr->second.string().c_str(), BIP::read_only);
+        BIP::mapped_region region(mapping, BIP::read_only);
+        region.advise(BIP::mapped_region::advice_sequential);
+
+        const char* data = reinterpret_cast<const char*>(region.get_address());
+        const auto& header = *reinterpret_cast<const Format::SegmentHeader*>(data);
+        if (region.get_size() < sizeof(header) || header.magic != Format::MAGIC || header.version != Format::VERSION) {
+            wlog("[ContractJournalReader] Skipping unrecognized segment ${P}", ("P", itr->second));
+            continue;
+        }
+        if (header.lastBlockNum < fromBlockNum)
+            continue;
+
+        auto used = std::min<uint64_t>(header.used, region.get_size());
+        for (uint64_t offset = sizeof(header); offset + sizeof(Format::FrameHeader) <= used;) {
+            const auto* frame = reinterpret_cast<const Format::FrameHeader*>(data + offset);
+            if (frame->size < sizeof(*frame) || offset + frame->size > used)
+                break;
+            offset += frame->size;
+            if (frame->blockNum < fromBlockNum)
+                continue;
+            ++scanned;
+            if (!f(Frame(frame)))
+                return scanned;
+        }
+    }
+    return scanned;
+}
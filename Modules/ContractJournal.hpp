@@ -0,0 +1,193 @@
+#pragma once
+
+#include "ChainHandler.hpp"
+
+#include <fc/filesystem.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// The on-disk format of the contract journal. This is the file format, so don't change it without bumping VERSION.
+//
+// The journal is a directory of segment files, each named for the number of the first block it holds. A segment is a
+// SegmentHeader followed by frames, one per contract per block, each holding the contract's changes in that block. All
+// structures are 8-byte aligned, so they can be read in place from a mapping of the file.
+struct ContractJournalFormat {
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t firstBlockNum;
+        uint32_t lastBlockNum;
+        // Bytes of the segment in use, including this header
+        uint64_t used;
+        uint64_t reserved[5];
+    };
+    struct FrameHeader {
+        // Size of the frame, including this header, its changes, and padding
+        uint32_t size;
+        uint32_t blockNum;
+        uint32_t changeCount;
+        uint8_t spaceId;
+        uint8_t reserved[3];
+        char blockId[20];
+        uint32_t reserved2;
+    };
+    // Each change is a ChangeHeader followed by the packed object, padded to 8 bytes. For deletions, the object is the
+    // object prior to deletion; otherwise, it's the object after the block.
+    struct ChangeHeader {
+        uint64_t instance;
+        uint32_t dataSize;
+        uint8_t typeId;
+        uint8_t operation;
+        uint16_t reserved;
+    };
+    static_assert(sizeof(SegmentHeader) == 64 && sizeof(FrameHeader) == 40 && sizeof(ChangeHeader) == 16,
+                  "Journal structures must have their documented sizes");
+
+    constexpr static uint32_t MAGIC = 0x4A434350; // "PCCJ"
+    constexpr static uint32_t VERSION = 1;
+
+    static constexpr size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+    static fc::path segmentPath(const fc::path& directory, uint32_t firstBlockNum);
+    // List the segment files in a directory, by the number of their first block
+    static std::map<uint32_t, fc::path> listSegments(const fc::path& directory);
+};
+
+// A persistent, append-only journal of the changes blocks make to contract databases.
+//
+// The journal records each contract's per-block change sets, as delivered by the block_changes signal of its monitor,
+// so that indexers can rebuild their views of contract state by reading the journal rather than re-running the node.
+// Records are states, not differences: each holds the object as a block left it, or as it was before a block deleted
+// it. Readers should therefore apply them as upserts and deletes.
+//
+// The journal is written through memory-mapped segment files, which rotate when full. Writes are flushed to disk in
+// batches. When the chain switches forks, the journal is truncated back to the fork point before the new fork's changes
+// are recorded; a fork's first change set then also carries the states the rolled back blocks left behind.
+class ContractJournal {
+public:
+    using block_id_type = protocol::block_id_type;
+
+    struct Options {
+        // Size of each segment file; a segment is only larger if a single frame requires it
+        size_t segmentSize = 64 * 1024 * 1024;
+        // Flush to disk once this many blocks are unflushed, or once this much time has passed since the last flush
+        uint32_t syncBlocks = 100;
+        std::chrono::milliseconds syncInterval{1000};
+    };
+
+    ContractJournal();
+    explicit ContractJournal(Options options) : options(options) {}
+    ~ContractJournal() { close(); }
+
+    // Open the journal in the given directory, creating it if it doesn't exist
+    void open(const fc::path& directory);
+    void close();
+    bool isOpen() const { return !directory.empty(); }
+
+    // Record a contract's changes in a block
+    void record(const ContractChangeSet& changeSet);
+    // Note that a block was applied, whether or not it changed any contracts. Rolls back the journal if the block is on
+    // a different fork than the journaled blocks.
+    void blockApplied(uint32_t blockNum, const block_id_type& blockId);
+    // Forget all blocks after the given block number
+    void truncate(uint32_t headBlockNum);
+    // Flush all journaled changes to disk
+    void sync();
+
+    // Number of the newest block in the journal, or zero if empty
+    uint32_t headBlockNum() const;
+    // ID of a recently journaled block, if it's known and changed any contracts
+    std::optional<block_id_type> blockId(uint32_t blockNum) const;
+
+private:
+    using Format = ContractJournalFormat;
+
+    const Options options;
+    fc::path directory;
+    // Segment files by first block number; the last is mapped for writing
+    std::map<uint32_t, fc::path> segments;
+    std::unique_ptr<boost::interprocess::file_mapping> mapping;
+    std::unique_ptr<boost::interprocess::mapped_region> region;
+
+    // IDs of recently journaled blocks, to detect fork switches
+    std::map<uint32_t, block_id_type> recentBlocks;
+    constexpr static size_t RECENT_BLOCKS = 10000;
+
+    uint64_t syncedTo = 0;
+    uint32_t unsyncedBlocks = 0;
+    std::chrono::steady_clock::time_point lastSync;
+
+    Format::SegmentHeader& segmentHeader() const {
+        return *reinterpret_cast<Format::SegmentHeader*>(region->get_address());
+    }
+    char* segmentData() const { return reinterpret_cast<char*>(region->get_address()); }
+
+    // Map the newest segment for writing, ensuring it has at least the given capacity
+    void mapCurrent(size_t minimumSize = 0);
+    void unmapCurrent();
+    // Make room for a frame of the given size, rotating to a new segment if necessary
+    void reserve(size_t frameSize, uint32_t blockNum);
+    void rollbackIfForked(uint32_t blockNum, const block_id_type& blockId);
+    void syncIfDue();
+    // Check that the frame at the given offset of the current segment is whole and within its used space
+    bool frameFits(uint64_t offset, uint64_t used) const;
+};
+
+// Reads a contract journal in place, through read-only mappings of its segments.
+//
+// The reader may be used while the journal is being written, by this or another process, and sees the changes which
+// were journaled as of when each segment is mapped.
+class ContractJournalReader {
+public:
+    using block_id_type = protocol::block_id_type;
+
+    // A journaled change. The data points into the mapped journal, and is valid only during the scan callback.
+    struct Change {
+        db::object_id_type id;
+        ContractChangeSet::Operation operation;
+        const char* data;
+        size_t size;
+    };
+
+    // A contract's changes in a block, as stored in the journal
+    class Frame {
+        const ContractJournalFormat::FrameHeader* header;
+
+    public:
+        explicit Frame(const ContractJournalFormat::FrameHeader* header) : header(header) {}
+
+        uint32_t blockNum() const { return header->blockNum; }
+        block_id_type blockId() const;
+        uint8_t spaceId() const { return header->spaceId; }
+        uint32_t changeCount() const { return header->changeCount; }
+
+        // Call f(const Change&) for each change in the frame
+        template<typename F>
+        void forEachChange(F&& f) const {
+            const char* position = reinterpret_cast<const char*>(header) + sizeof(*header);
+            for (uint32_t i = 0; i < header->changeCount; ++i) {
+                const auto* change = reinterpret_cast<const ContractJournalFormat::ChangeHeader*>(position);
+                position += sizeof(*change);
+                f(Change{db::object_id_type(header->spaceId, change->typeId, change->instance),
+                         static_cast<ContractChangeSet::Operation>(change->operation), position, change->dataSize});
+                position += ContractJournalFormat::padded(change->dataSize);
+            }
+        }
+    };
+
+    explicit ContractJournalReader(const fc::path& directory) : directory(directory) {}
+
+    // Call f(const Frame&) for each frame of the blocks numbered fromBlockNum or later, in journal order, until f
+    // returns false. Returns the number of frames scanned.
+    size_t scan(uint32_t fromBlockNum, const std::function<bool(const Frame&)>& f) const;
+
+private:
+    fc::path directory;
+};
@@ -1,21 +1,64 @@
 #include "ContractNode.hpp"
 
-#include <ContractApi.hpp>
-
 #include <fc/interprocess/signals.hpp>
+#include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/asio.hpp>
 
 #include <boost/dll/runtime_symbol_info.hpp>
 
+#include <algorithm>
+#include <iostream>
+
 namespace Node {
 
+constexpr static auto USAGE =
+R"(Usage: ContractNode [options]
+  --journal                 Keep a journal of the changes blocks make to contract databases, under the configuration
+                            directory
+  --import-snapshot <file>  Start a new node from a snapshot, like one exported on SIGHUP to snapshot.bin in the
+                            configuration directory. Fails if the node already has a chain.
+  --evaluator-stats <secs>  Measure the evaluators of contracts which support it, and log their statistics this often
+  --help                    Show this message
+)";
+
+bool ContractNode::parseOptions() {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help") {
+                std::cout << USAGE;
+                return false;
+            } else if (arg == "--journal") {
+                options.journal = true;
+            } else if (arg == "--import-snapshot") {
+                FC_ASSERT(i + 1 < argc, "Missing value for ${A}", ("A", arg));
+                options.importSnapshot = fc::path(argv[++i]);
+            } else if (arg == "--evaluator-stats") {
+                FC_ASSERT(i + 1 < argc, "Missing value for ${A}", ("A", arg));
+                options.evaluatorStatsInterval = std::stoul(argv[++i]);
+                FC_ASSERT(options.evaluatorStatsInterval > 0, "${A} must be at least one second", ("A", arg));
+            } else {
+                FC_THROW("Unknown option ${A}", ("A", arg));
+            }
+        }
+    } catch (const fc::exception& e) {
+        std::cerr << e.to_string() << "\n\n" << USAGE;
+        return false;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n\n" << USAGE;
+        return false;
+    }
+    return true;
+}
+
 bool ContractNode::waitForExit() {
     exitPromise = fc::promise<bool>::create("Exit promise");
 
     // Set signal handler
     if (signalSet == nullptr) {
         signalSet.reset(new boost::asio::signal_set(fc::asio::default_io_service(), SIGINT, SIGUSR1, SIGUSR2));
+        signalSet->add(SIGHUP);
         signalSet->async_wait([this](auto a, auto b) { signalHandler(a, b); });
     }
 
@@ -39,6 +82,20 @@ void ContractNode::signalHandler(boost::system::error_code error, int signal) {
         // Async this to keep signal handler snappy
         mainThread.async([this] { this->dumpContractDatabases(); },
                   "SIGUSR2 Handler");
+    } else if (signal == SIGHUP) {
+        ilog("Received SIGHUP -- exporting snapshot");
+        // Async this to keep signal handler snappy
+        mainThread.async([this] {
+            // Applying blocks would change the files being copied into the snapshot, so hold them until it's written
+            std::shared_ptr<void> hold;
+            if (p2pHandler)
+                hold = p2pHandler->holdBlocks();
+            try {
+                chainHandler->exportSnapshot(chainHandler->getSnapshotPath());
+            } catch (const fc::exception& e) {
+                elog("Failed to export snapshot: ${e}", ("e", e.to_detail_string()));
+            }
+        }, "SIGHUP Handler");
     }
 
     // Re-set the signal handler
@@ -52,24 +109,30 @@ void ContractNode::initializeBlockchain() {
         elog("Cannot initialize blockchain: ChainHandler not yet created!");
         return;
     }
-    chainHandler->initialize();
+    {
+        auto profile = startupProfiler.phase("initializeDatabases");
+        chainHandler->initialize();
+    }
 
     auto programPath = DLL::program_location().parent_path();
     ilog("Node path: ${P}", ("P", programPath.string()));
-    initializePlugins(searchForPlugins(programPath));
+    auto profile = startupProfiler.phase("searchForPlugins");
+    auto pluginPaths = searchForPlugins(programPath);
+    profile.end();
+    initializePlugins(std::move(pluginPaths));
 }
 
 bool ContractNode::loadPlugin(BFS::path file) {
+    auto profile = startupProfiler.phase("load " + file.filename().string());
     try {
         ilog("Checking plugin ${P}", ("P", file.string()));
-        auto plugin = std::make_unique<DLL::shared_library>(file);
-        if (plugin->is_loaded() && plugin->has("registerContract")) {
+        auto plugin = ContractPlugin::load(file);
+        if (plugin != nullptr) {
             ilog("Loaded plugin: ${P}", ("P", file.string()));
             loadedLibraries.emplace(file, std::move(plugin));
             return true;
         } else {
             ilog("Plugin failed to load: ${P}", ("P", file.string()));
-            plugin.reset();
             return false;
         }
     } catch (const boost::system::system_error& e) {
@@ -80,80 +143,67 @@ bool ContractNode::loadPlugin(BFS::path file) {
 
 std::vector<BFS::path> ContractNode::loadPlugins(BFS::path directory) {
     std::vector<BFS::path> loadedPlugins;
-    directory = BFS::weakly_canonical(directory);
-    ilog("Searching for plugins in ${D}", ("D", directory.string()));
-
-    if (!BFS::is_directory(directory))
-        return loadedPlugins;
-
-    // Search directory for files with the right extension that we haven't already loaded
-    for(BFS::directory_iterator file(directory); file != BFS::directory_iterator(); ++file) {
-        auto path = file->path();
-        std::set<BFS::path> checkedExtensions = {".so", ".dylib", ".dll"};
-        if (checkedExtensions.count(path.extension()) &&
-                loadedLibraries.count(path) == 0) {
-            if (loadPlugin(path))
-                loadedPlugins.emplace_back(path);
-        }
-    }
+
+    // Load the libraries we haven't already loaded
+    for (const auto& path : ContractPlugin::listLibraries(directory))
+        if (loadedLibraries.count(path) == 0 && loadPlugin(path))
+            loadedPlugins.emplace_back(path);
 
     return loadedPlugins;
 }
 
 std::vector<BFS::path> ContractNode::searchForPlugins(BFS::path programPath) {
-    auto loadedPlugins = loadPlugins(programPath / "plugins");
-    auto binaryName = DLL::program_location().stem();
-    auto more = loadPlugins(programPath / "../lib" / binaryName / "plugins");
-    loadedPlugins.insert(loadedPlugins.end(),
-                         std::make_move_iterator(more.begin()), std::make_move_iterator(more.end()));
+    std::vector<BFS::path> loadedPlugins;
+    for (const auto& directory : ContractPlugin::searchDirectories(programPath, DLL::program_location().stem())) {
+        auto more = loadPlugins(directory);
+        loadedPlugins.insert(loadedPlugins.end(),
+                             std::make_move_iterator(more.begin()), std::make_move_iterator(more.end()));
+    }
     return loadedPlugins;
 }
 
 bool ContractNode::initializePlugin(LibraryPointer& library) {
     std::string contractName = library->location().filename().string();
+    auto profile = startupProfiler.phase("plugin " + contractName);
 
     // Try to initialize the contract
     try {
-        if (library->has("contractName"))
-            contractName = library->template get<const char*>("contractName");
-
-        const StringList* tables = nullptr;
-        if (library->has("tableNames"))
-            tables = library->template get<const StringList*>("tableNames");
-
-        auto initialize = library->template get<bool(graphene::chain::database&, uint8_t)>("registerContract");
-        if (chainHandler->initializeContract(contractName, initialize)) {
-            auto monitor = chainHandler->observeContract(contractName);
-            monitor->object_created.connect([tables, contractName](uint8_t type, const fc::variant_object& o) {
-                std::string tableName;
-                if (tables && tables->count > type)
-                    tableName = tables->values[type];
-                else
-                    tableName = std::to_string(type);
-
-                dlog("Contract ${C} has created a new object in its ${T} table:\n${O}",
-                     ("C", contractName)("T", tableName)("O", o));
-            });
-            monitor->object_deleted.connect([tables, contractName](uint8_t type, const fc::variant_object& o) {
-                std::string tableName;
-                if (tables && tables->count > type)
-                    tableName = tables->values[type];
-                else
-                    tableName = std::to_string(type);
-
-                dlog("Contract ${C} has deleted an object in its ${T} table:\n${O}",
-                     ("C", contractName)("T", tableName)("O", o));
-            });
-            monitor->object_modified.connect([tables, contractName](uint8_t type, const fc::variant_object& o) {
-                std::string tableName;
-                if (tables && tables->count > type)
-                    tableName = tables->values[type];
-                else
-                    tableName = std::to_string(type);
+        auto exports = ContractPlugin::readExports(*library);
+        contractName = exports.name;
+        if (chainHandler->initializeContract(contractName, exports.registerContract, exports.indexedFields,
+                                             exports.tableNames, exports.tableReflections)) {
+            if (exports.evaluatorObserver != nullptr) {
+                auto& measured = measuredContracts[contractName];
+                measured.observer = exports.evaluatorObserver;
+                if (measured.stats == nullptr)
+                    measured.stats = std::make_unique<EvaluatorStats>(contractName);
+                *measured.observer = evaluatorStatsEnabled? measured.stats.get() : nullptr;
+            }
 
-                dlog("Contract ${C} has modified an object in its ${T} table:\n${O}",
-                     ("C", contractName)("T", tableName)("O", o));
-            });
+            const auto& contract = chainHandler->getContractRegistry().get(contractName);
+            auto monitor = chainHandler->observeContract(contract.spaceId, contract.name);
+            // This slot only logs at debug level; if that's disabled, don't subscribe, so the tables aren't monitored.
+            // The logging is done on the change dispatcher's thread, to keep it out of block application.
+            if (fc::logger::get(DEFAULT_LOGGER).is_enabled(fc::log_level::debug)) {
+                changeDispatcher.relay(*monitor, [&contract](const AsyncChangeDispatcher::ChangeRecord& c) {
+                    auto tableName = contract.tableName(c.typeId);
+
+                    switch (c.operation) {
+                    case AsyncChangeDispatcher::Operation::Created:
+                        dlog("Contract ${C} has created a new object in its ${T} table:\n${O}",
+                             ("C", contract.name)("T", tableName)("O", c.event().variant()));
+                        break;
+                    case AsyncChangeDispatcher::Operation::Deleted:
+                        dlog("Contract ${C} has deleted an object in its ${T} table:\n${O}",
+                             ("C", contract.name)("T", tableName)("O", c.event().variant()));
+                        break;
+                    case AsyncChangeDispatcher::Operation::Modified:
+                        dlog("Contract ${C} has modified an object in its ${T} table:\n${O}",
+                             ("C", contract.name)("T", tableName)("O", c.event().variant()));
+                        break;
+                    }
+                });
+            }
             contractMonitors.emplace_back(std::move(monitor));
 
             ilog("Contract ${N} initialized successfully.", ("N", contractName));
@@ -180,42 +230,157 @@ void ContractNode::initializePlugins(std::vector<BFS::path> pluginPaths) {
     }
 }
 
+void ContractNode::setEvaluatorStatsEnabled(bool enabled) {
+    evaluatorStatsEnabled = enabled;
+    for (auto& [name, measured] : measuredContracts)
+        *measured.observer = enabled? measured.stats.get() : nullptr;
+}
+
+void ContractNode::reportEvaluatorStats() {
+    // If no evaluator ran since the last report, there's nothing new to report
+    std::chrono::nanoseconds total{0};
+    for (const auto& [name, measured] : measuredContracts)
+        total += measured.stats->totalTime();
+    if (total != lastReportedEvaluatorTime) {
+        lastReportedEvaluatorTime = total;
+        ilog("Contract evaluator statistics: ${S}", ("S", fc::json::to_string(getEvaluatorStats())));
+    }
+
+    evaluatorStatsTask = fc::schedule([this] { reportEvaluatorStats(); },
+                                      fc::time_point::now() + fc::seconds(options.evaluatorStatsInterval),
+                                      "Evaluator statistics report");
+}
+
+fc::variants ContractNode::getEvaluatorStats() const {
+    std::vector<const EvaluatorStats*> stats;
+    for (const auto& [name, measured] : measuredContracts)
+        stats.push_back(measured.stats.get());
+    std::sort(stats.begin(), stats.end(), [](const auto* a, const auto* b) { return a->totalTime() > b->totalTime(); });
+
+    fc::variants result;
+    for (const auto* contractStats : stats)
+        result.emplace_back(contractStats->report());
+    return result;
+}
+
 void ContractNode::dumpContractDatabases() const {
-    for (const auto& [id, name] : chainHandler->getLoadedContracts()) {
+    const auto& registry = chainHandler->getContractRegistry();
+    for (const auto& [id, name] : registry.names()) {
         dlog("Dumping database for contract: ${N}", ("N", name));
-        auto dumper = [typeId=-1](const fc::variant_object& object) mutable {
-            if (object.contains("id")) {
-                auto newTypeId = object.find("id")->value().as<db::object_id_type>(1).type();
-                if (newTypeId != typeId) {
-                    typeId = newTypeId;
-                    // TODO: Convert table type ID to table name
-                    // This will require some refactoring to make contracts indexable by space ID
-                    dlog("");
+        const auto& contract = registry.get(id);
+        auto dumper = [&contract, typeId=-1](const db::object& object) mutable {
+            auto newTypeId = object.id.type();
+            if (newTypeId != typeId) {
+                typeId = newTypeId;
+                const auto* table = contract.findTable(typeId);
+                dlog("");
+                if (table != nullptr)
+                    dlog("Table ${T} (${N} objects):", ("T", table->name)("N", table->stats.objects));
+                else
                     dlog("Table ${T}:", ("T", typeId));
-                }
             }
 
-            ddump((object));
+            auto variant = object.to_variant();
+            ddump((variant));
         };
-        chainHandler->inspectContractDatabase(id, dumper);
+        // Stream the database in chunks, so blocks can still be applied while a large database is dumped
+        chainHandler->streamContractDatabase(id, dumper, 100);
     }
 }
 
-ContractNode::ContractNode(char* argv, char** argc) : argv(argv), argc(argc), mainThread(fc::thread::current()) {}
-ContractNode::~ContractNode() {}
+void ContractNode::processBlock(const chain::signed_block& block) {
+    auto& chain = chainHandler->getChain();
+    if (block.previous != chain.head_block_id()) {
+        if (reorderBuffer.insert(block, chain.head_block_num()))
+            dlog("Got block #${num} ahead of head block #${head}; holding it until the gap is filled",
+                 ("num", block.block_num())("head", chain.head_block_num()));
+        else
+            wlog("Got a block, but it's not the next one in the chain. Ignoring it.");
+        return;
+    }
+
+    if (!pushBlock(block))
+        return;
+
+    // Now that the head has moved, apply any buffered blocks that follow it
+    size_t drained = 0;
+    while (auto next = reorderBuffer.takeNext(chain.head_block_id(), chain.head_block_num())) {
+        if (!pushBlock(*next))
+            break;
+        ++drained;
+    }
+    if (drained > 0) {
+        const auto& counters = reorderBuffer.getCounters();
+        dlog("Applied ${n} buffered blocks; ${left} still buffered. Totals: ${b} buffered, ${d} drained, ${e} evicted",
+             ("n", drained)("left", reorderBuffer.size())
+             ("b", counters.buffered)("d", counters.drained)("e", counters.evicted));
+    }
+}
+
+bool ContractNode::pushBlock(const chain::signed_block& block) {
+    ilog("Received next block in chain: #${num}, block time ${time}",
+         ("num", block.block_num())("time", block.timestamp));
+    try {
+        auto start = fc::time_point::now();
+        chainHandler->getChain().push_block(block);
+        p2pHandler->blockPushed(block, fc::time_point::now() - start);
+        FC_ASSERT(chainHandler->getChain().head_block_id() == block.id(), "Block pushed OK, but did not update chain");
+        return true;
+    } catch (const fc::exception& e) {
+        elog("Failed to push block to chain: ${e}", ("e", e.to_detail_string()));
+        return false;
+    }
+}
+
+ContractNode::ContractNode(int argc, char** argv) : argc(argc), argv(argv), mainThread(fc::thread::current()) {}
+ContractNode::~ContractNode() {
+    if (evaluatorStatsTask.valid() && !evaluatorStatsTask.ready())
+        evaluatorStatsTask.cancel_and_wait("ContractNode destroyed");
+}
 
 int ContractNode::run() {
+    if (!parseOptions())
+        return 2;
+
+    // Count the objects in contract databases as startup proceeds
+    startupProfiler.setObjectCounter([this] {
+        uint64_t objects = 0;
+        if (chainHandler) {
+            const auto& registry = chainHandler->getContractRegistry();
+            for (const auto& contract : registry.names())
+                for (const auto& table : registry.get(contract.first).getTables())
+                    objects += table.second.stats.objects;
+        }
+        return objects;
+    });
+
     // OK, time to start the program. First, create the chain, initialize the blockchain, and open the database.
     try {
         ilog("Creating blockchain");
+        auto profile = startupProfiler.phase("createChain");
         chainHandler = std::make_unique<ChainHandler>();
+        chainHandler->setJournalEnabled(options.journal);
+        setEvaluatorStatsEnabled(options.evaluatorStatsInterval > 0);
         ilog("Contract node configuration directory: ${D}", ("D", chainHandler->getConfigPath()));
+        profile.end();
+
+        // A new node with a snapshot to start from can skip syncing up to the snapshot's block
+        if (options.importSnapshot.has_value()) {
+            ilog("Importing snapshot ${P}", ("P", *options.importSnapshot));
+            profile = startupProfiler.phase("importSnapshot");
+            chainHandler->importSnapshot(*options.importSnapshot);
+            profile.end();
+        }
 
         ilog("Initializing blockchain");
+        profile = startupProfiler.phase("initializeBlockchain");
         initializeBlockchain();
+        profile.end();
 
         ilog("Loading database");
+        profile = startupProfiler.phase("openChain");
         chainHandler->open();
+        profile.end();
         ilog("Blockchain opened successfully at block #${num}", ("num", chainHandler->getChain().head_block_num()));
         ilog("Chain ID is ${cid}", ("cid", chainHandler->getChain().get_chain_id()));
     } catch (const fc::exception& e) {
@@ -226,32 +391,31 @@ int ContractNode::run() {
     try {
         // Now create the P2P node, giving it read access to the chain database
         ilog("Creating P2P Node");
-        p2pHandler = std::make_unique<P2pHandler>(chainHandler->getChain());
+        auto profile = startupProfiler.phase("createP2p");
+        p2pHandler = std::make_unique<P2pHandler>(chainHandler->getChain(), &chainHandler->getHeaderIndex());
         blockConnection = p2pHandler->blockReceived.connect([this](const chain::signed_block& block) {
-            if (block.previous == chainHandler->getChain().head_block_id()) {
-                ilog("Received next block in chain: #${num}, block time ${time}",
-                     ("num", block.block_num())("time", block.timestamp));
-                try {
-                    chainHandler->getChain().push_block(block);
-                    FC_ASSERT(chainHandler->getChain().head_block_id() == block.id(),
-                              "Block pushed OK, but did not update chain");
-                } catch (const fc::exception& e) {
-                    elog("Failed to push block to chain: ${e}", ("e", e.to_detail_string()));
-                }
-            } else {
-                wlog("Got a block, but it's not the next one in the chain. Ignoring it.");
-            }
+            processBlock(block);
         });
+        appliedBlockConnection = chainHandler->getChain().applied_block.connect(
+            [this](const chain::signed_block& block) {
+                p2pHandler->blockApplied(block);
+                changeDispatcher.flush();
+            });
         transactionConnection = p2pHandler->transactionReceived.connect([](const chain::signed_transaction& trx) {
-            ilog("Got TRX ID ${id}, but I don't care about transactions, so I'm ignoring it.", ("id", trx.id()));
+            dlog("Got TRX ID ${id}; holding it in the transaction pool.", ("id", trx.id()));
         });
 
+        profile.end();
+
         // Connect P2P node to seed nodes
         ilog("Connecting to seed nodes");
+        profile = startupProfiler.phase("connectToSeeds");
         p2pHandler->connectToSeeds();
+        profile.end();
 
         // Begin sync
         ilog("Beginning sync");
+        profile = startupProfiler.phase("beginSync");
         p2pHandler->syncFrom(chainHandler->getChain().head_block_id());
     } catch (const fc::exception& e) {
         elog("Failed to initialize P2P Node: ${e}", ("e", e.to_detail_string()));
@@ -259,6 +423,15 @@ int ContractNode::run() {
     }
 
     ilog("Node stable");
+    const auto& report = startupProfiler.finish();
+    ilog("Startup profile: ${R}", ("R", fc::json::to_string(fc::variant(report, 10))));
+    try {
+        StartupProfiler::writeReport(report, chainHandler->getConfigPath() / "startup-profile.json");
+    } catch (const fc::exception& e) {
+        wlog("Failed to write startup profile: ${e}", ("e", e.to_string()));
+    }
+    if (options.evaluatorStatsInterval > 0)
+        reportEvaluatorStats();
     return waitForExit();
 }
 
@@ -2,6 +2,11 @@
 
 #include "P2pHandler.hpp"
 #include "ChainHandler.hpp"
+#include "BlockReorderBuffer.hpp"
+#include "AsyncChangeDispatcher.hpp"
+#include "StartupProfiler.hpp"
+#include "ContractPlugin.hpp"
+#include "EvaluatorStats.hpp"
 
 #include <Infra/Infra.hpp>
 #include <Infra/ApiManager.hpp>
@@ -21,17 +26,48 @@ namespace DLL = boost::dll;
 namespace BFS = DLL::fs;
 
 class ContractNode {
-    char* argv = nullptr;
-    char** argc = nullptr;
+    int argc = 0;
+    char** argv = nullptr;
+    // Settings given on the command line
+    struct Options {
+        // Keep a journal of the changes blocks make to contract databases
+        bool journal = false;
+        // A snapshot to start a new node from
+        std::optional<fc::path> importSnapshot;
+        // Seconds between logs of contract evaluator statistics; zero leaves evaluators unmeasured
+        uint32_t evaluatorStatsInterval = 0;
+    };
+    Options options;
+    // Parse the command line into options, returning false if it's invalid
+    bool parseOptions();
+
     std::unique_ptr<ChainHandler> chainHandler;
     std::unique_ptr<P2pHandler> p2pHandler;
     std::unique_ptr<boost::asio::signal_set> signalSet;
     std::vector<std::unique_ptr<ChainHandler::ContractDatabaseMonitor>> contractMonitors;
 
     fc::thread& mainThread;
+    // Profile of the phases of startup, reported once the node is stable
+    StartupProfiler startupProfiler;
 
     using LibraryPointer = std::unique_ptr<boost::dll::shared_library>;
     std::map<BFS::path, LibraryPointer> loadedLibraries;
+    // Timings of each contract's evaluators, for contracts which support measuring them, by contract name
+    struct MeasuredContract {
+        // The contract's evaluator observer variable
+        EvaluatorObserver** observer = nullptr;
+        std::unique_ptr<EvaluatorStats> stats;
+    };
+    std::map<std::string, MeasuredContract> measuredContracts;
+    bool evaluatorStatsEnabled = false;
+    // The task that periodically logs the evaluator statistics, and their total time as of the last log, to skip
+    // logging when nothing has run
+    fc::future<void> evaluatorStatsTask;
+    std::chrono::nanoseconds lastReportedEvaluatorTime{0};
+    void reportEvaluatorStats();
+    // Delivers contract database events to our subscribers off the thread applying blocks. Declared after the monitors
+    // and the contract libraries, so it's destroyed, and stops delivering, before they go.
+    AsyncChangeDispatcher changeDispatcher;
     fc::promise<bool>::ptr exitPromise;
 
     void initializeBlockchain();
@@ -44,18 +80,33 @@ class ContractNode {
 
     void dumpContractDatabases() const;
 
+    // Blocks which arrived before the block they follow; applied once the chain catches up to them
+    BlockReorderBuffer reorderBuffer;
+    // Apply a block received from the network, buffering it if it's early
+    void processBlock(const chain::signed_block& block);
+    // Push a block which links onto the head into the chain. Returns true if the chain accepted it.
+    bool pushBlock(const chain::signed_block& block);
+
     bool waitForExit();
     void signalHandler(boost::system::error_code error, int signal);
 
     std::optional<Sgnl::connection> blockConnection;
     std::optional<Sgnl::connection> transactionConnection;
+    std::optional<Sgnl::connection> appliedBlockConnection;
 
 public:
-    ContractNode(char* argv = nullptr, char** argc = nullptr);
+    ContractNode(int argc = 0, char** argv = nullptr);
     ~ContractNode();
 
     ChainHandler* getChainHandler() { return chainHandler.get(); }
     P2pHandler* getP2pHandler() { return p2pHandler.get(); }
+    // Get the startup profile. It's complete once the node is stable.
+    const StartupProfiler& getStartupProfiler() const { return startupProfiler; }
+
+    // Enable or disable measuring contract evaluators. While disabled, evaluators aren't timed at all.
+    void setEvaluatorStatsEnabled(bool enabled);
+    // Get the evaluator statistics of each measured contract, the contract spending the most time in them first
+    fc::variants getEvaluatorStats() const;
 
     int run();
     void exit(bool withError) { exitPromise->set_value(withError); }
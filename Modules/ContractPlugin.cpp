@@ -0,0 +1,68 @@
+#include "ContractPlugin.hpp"
+
+#include <ContractApi.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <set>
+
+std::vector<ContractPlugin::Path> ContractPlugin::searchDirectories(const Path& programPath, const Path& programName) {
+    return {programPath / "plugins", programPath / "../lib" / programName / "plugins"};
+}
+
+std::vector<ContractPlugin::Path> ContractPlugin::listLibraries(Path directory) {
+    std::vector<Path> libraries;
+    directory = boost::dll::fs::weakly_canonical(directory);
+    ilog("Searching for plugins in ${D}", ("D", directory.string()));
+
+    if (!boost::dll::fs::is_directory(directory))
+        return libraries;
+
+    // Search directory for files with the right extension
+    const std::set<Path> checkedExtensions = {".so", ".dylib", ".dll"};
+    for (boost::dll::fs::directory_iterator file(directory); file != boost::dll::fs::directory_iterator(); ++file)
+        if (checkedExtensions.count(file->path().extension()))
+            libraries.emplace_back(file->path());
+
+    return libraries;
+}
+
+ContractPlugin::LibraryPointer ContractPlugin::load(const Path& file) {
+    auto plugin = std::make_unique<boost::dll::shared_library>(file);
+    if (plugin->is_loaded() && plugin->has("registerContract"))
+        return plugin;
+    return {};
+}
+
+ContractPlugin::Exports ContractPlugin::readExports(boost::dll::shared_library& library) {
+    Exports exports;
+    exports.name = library.location().filename().string();
+    if (library.has("contractName"))
+        exports.name = library.get<const char*>("contractName");
+
+    if (library.has("tableNames")) {
+        const auto* list = library.get<const StringList*>("tableNames");
+        if (list != nullptr)
+            exports.tableNames.assign(list->values, list->values + list->count);
+    }
+
+    if (library.has("indexedFields")) {
+        const auto* list = library.get<const IndexedFieldList*>("indexedFields");
+        if (list != nullptr)
+            for (uint32_t i = 0; i < list->count; ++i)
+                exports.indexedFields.emplace_back(list->fields[i].typeId, list->fields[i].field);
+    }
+
+    if (library.has("tableReflections")) {
+        const auto* list = library.get<const TableReflectionList*>("tableReflections");
+        if (list != nullptr)
+            for (uint32_t i = 0; i < list->count; ++i)
+                exports.tableReflections.push_back(&list->tables[i]);
+    }
+
+    if (library.has("evaluatorObserver"))
+        exports.evaluatorObserver = &library.get<EvaluatorObserver*>("evaluatorObserver");
+
+    exports.registerContract = library.get<bool(graphene::chain::database&, uint8_t)>("registerContract");
+    return exports;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <boost/dll/shared_library.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class EvaluatorObserver;
+struct TableReflection;
+
+// Finding, loading, and reading the exports of contract plugins: shared libraries implementing the ContractApi.
+class ContractPlugin {
+public:
+    using Path = boost::dll::fs::path;
+    using LibraryPointer = std::unique_ptr<boost::dll::shared_library>;
+
+    // What a contract plugin exports, as the node uses it
+    struct Exports {
+        // The contract's name, or the library's file name if it doesn't name itself
+        std::string name;
+        std::function<bool(graphene::chain::database&, uint8_t)> registerContract;
+        std::vector<std::string> tableNames;
+        std::vector<std::pair<uint8_t, std::string>> indexedFields;
+        // Reflections of the contract's tables' object types, for the tables it reflects
+        std::vector<const TableReflection*> tableReflections;
+        // The plugin's evaluator observer variable, to set to measure its evaluators, or null if it has none
+        EvaluatorObserver** evaluatorObserver = nullptr;
+    };
+
+    // Get the directories to search for the plugins of a program, given the directory the program is in and its name
+    static std::vector<Path> searchDirectories(const Path& programPath, const Path& programName);
+    // List the shared libraries in a directory
+    static std::vector<Path> listLibraries(Path directory);
+    // Load a library, returning null if it isn't a contract plugin. Throws if the library can't be loaded at all.
+    static LibraryPointer load(const Path& file);
+    // Read a loaded plugin's exports
+    static Exports readExports(boost::dll::shared_library& library);
+};
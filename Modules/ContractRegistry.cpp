@@ -0,0 +1,89 @@
+#include "ContractRegistry.hpp"
+
+namespace db = graphene::db;
+
+namespace {
+// Keeps a table's statistics up to date
+struct TableStatsIndex : public db::secondary_index {
+    ContractRegistry::TableStats* stats = nullptr;
+
+    // secondary_index interface
+    void object_loaded(const db::object&) override { ++stats->objects; }
+    void object_created(const db::object&) override {
+        ++stats->objects;
+        ++stats->created;
+    }
+    void object_removed(const db::object&) override {
+        --stats->objects;
+        ++stats->deleted;
+    }
+    void object_modified(const db::object&) override { ++stats->modified; }
+};
+} // namespace
+
+const ContractRegistry::Contract& ContractRegistry::add(chain::database& db, uint8_t spaceId, const std::string& name,
+                                                        const std::vector<std::string>& tableNames,
+                                                        const std::vector<const TableReflection*>& reflections) {
+    auto& contract = bySpace[spaceId];
+    if (contract == nullptr) {
+        FC_ASSERT(byName.count(name) == 0, "[ContractRegistry] Contract ${N} is already registered with space ID ${S}",
+                  ("N", name)("S", byName[name]->spaceId));
+        contract = std::make_unique<Contract>();
+        contract->spaceId = spaceId;
+        contract->name = name;
+        byName.emplace(name, contract.get());
+        contractNames.emplace(spaceId, name);
+    }
+    FC_ASSERT(contract->name == name, "[ContractRegistry] Space ID ${S} is already registered to contract ${N}",
+              ("S", spaceId)("N", contract->name));
+
+    // Find the contract's tables, and start keeping their statistics
+    db.inspect_all_indexes(spaceId, [&db, &contract, spaceId](const db::index& index) {
+        auto typeId = index.object_type_id();
+        if (contract->tables.count(typeId))
+            return;
+        auto& table = contract->tables[typeId];
+        table.typeId = typeId;
+        table.name = std::to_string(typeId);
+
+        auto* statsIndex = db.add_secondary_index<TableStatsIndex>(spaceId, typeId);
+        statsIndex->stats = &table.stats;
+        // If the table was loaded before we got here, count what's in it
+        index.inspect_all_objects([&table](const db::object&) { ++table.stats.objects; });
+    });
+
+    for (size_t typeId = 0; typeId < tableNames.size() && typeId < 256; ++typeId) {
+        auto itr = contract->tables.find(typeId);
+        if (itr == contract->tables.end()) {
+            wlog("[ContractRegistry] Contract ${C} names table ${T} \"${N}\", but has no such table",
+                 ("C", name)("T", typeId)("N", tableNames[typeId]));
+            continue;
+        }
+        contract->tableIds.erase(itr->second.name);
+        itr->second.name = tableNames[typeId];
+        contract->tableIds[tableNames[typeId]] = typeId;
+    }
+
+    for (const auto* reflection : reflections) {
+        auto itr = contract->tables.find(reflection->typeId);
+        if (itr == contract->tables.end())
+            wlog("[ContractRegistry] Contract ${C} reflects table ${T}, but has no such table",
+                 ("C", name)("T", reflection->typeId));
+        else
+            itr->second.reflection = reflection;
+    }
+
+    return *contract;
+}
+
+const ContractRegistry::Contract& ContractRegistry::get(uint8_t spaceId) const {
+    const auto* contract = find(spaceId);
+    FC_ASSERT(contract != nullptr, "[ContractRegistry] Could not find contract with space ID ${S}", ("S", spaceId));
+    return *contract;
+}
+
+const ContractRegistry::Contract& ContractRegistry::get(const std::string& name) const {
+    const auto* contract = find(name);
+    FC_ASSERT(contract != nullptr, "[ContractRegistry] Could not find contract named ${N}", ("N", name));
+    return *contract;
+}
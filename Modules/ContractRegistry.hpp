@@ -0,0 +1,91 @@
+#pragma once
+
+#include <ContractApi.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chain = graphene::chain;
+
+// The registry of contracts loaded into the chain, with their tables.
+//
+// Contracts are found by name or by space ID, and a contract's tables by name or by type ID, all in constant time. Each
+// table has live statistics, maintained by a secondary index on the table. Entries are never removed, so references
+// to them remain valid for the registry's lifetime; their names and tables don't change after they're added, so they
+// may be read from any thread, but the statistics are updated by the thread applying blocks.
+class ContractRegistry {
+public:
+    struct TableStats {
+        // Objects currently in the table
+        uint64_t objects = 0;
+        // Objects created, modified, and deleted since the contract was loaded, including by blocks later popped
+        uint64_t created = 0;
+        uint64_t modified = 0;
+        uint64_t deleted = 0;
+    };
+    struct Table {
+        uint8_t typeId = 0;
+        std::string name;
+        // The reflection of the table's object type, if the contract provided one
+        const TableReflection* reflection = nullptr;
+        TableStats stats;
+    };
+    class Contract {
+        friend class ContractRegistry;
+        std::map<uint8_t, Table> tables;
+        std::unordered_map<std::string, uint8_t> tableIds;
+
+    public:
+        uint8_t spaceId = 0;
+        std::string name;
+
+        // Get the contract's tables, in type ID order
+        const std::map<uint8_t, Table>& getTables() const { return tables; }
+        // Find a table by type ID or by name, returning null if there is none
+        const Table* findTable(uint8_t typeId) const {
+            auto itr = tables.find(typeId);
+            return itr == tables.end()? nullptr : &itr->second;
+        }
+        const Table* findTable(const std::string& tableName) const {
+            auto itr = tableIds.find(tableName);
+            return itr == tableIds.end()? nullptr : findTable(itr->second);
+        }
+        // Get a table's name; tables the contract didn't name are named by their type ID
+        std::string tableName(uint8_t typeId) const {
+            const auto* table = findTable(typeId);
+            return table == nullptr? std::to_string(typeId) : table->name;
+        }
+    };
+
+    // Register a contract which has been loaded into the chain at the given space ID. Its tables are found in the
+    // chain, named by tableNames in type ID order, so far as it goes, and given the reflections which match their type
+    // IDs. Registering a contract again returns the existing entry, naming and reflecting any tables it didn't before.
+    const Contract& add(chain::database& db, uint8_t spaceId, const std::string& name,
+                        const std::vector<std::string>& tableNames = {},
+                        const std::vector<const TableReflection*>& reflections = {});
+
+    const Contract* find(uint8_t spaceId) const { return bySpace[spaceId].get(); }
+    const Contract* find(const std::string& name) const {
+        auto itr = byName.find(name);
+        return itr == byName.end()? nullptr : itr->second;
+    }
+    // Get a contract, throwing if it isn't registered
+    const Contract& get(uint8_t spaceId) const;
+    const Contract& get(const std::string& name) const;
+
+    // Get a map of space ID to name for all registered contracts
+    const std::map<uint8_t, std::string>& names() const { return contractNames; }
+    size_t size() const { return contractNames.size(); }
+
+private:
+    std::array<std::unique_ptr<Contract>, 256> bySpace;
+    std::unordered_map<std::string, Contract*> byName;
+    std::map<uint8_t, std::string> contractNames;
+};
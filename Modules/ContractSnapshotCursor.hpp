@@ -0,0 +1,76 @@
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <optional>
+
+// Walks the objects in a contract's database in bounded chunks, so a snapshot of a large contract needn't hold up the
+// thread applying blocks.
+//
+// Objects are visited in ID order, by probing each table for each instance ID it has assigned, and are handed to the
+// visitor as typed references; visitors wanting raw serialized objects can pack() them. The cursor's position is just
+// the next ID to visit, so the walk may be suspended between chunks while blocks are applied, and resumed later, even
+// by a new cursor. The walk is not isolated from those blocks: objects created behind the cursor or deleted ahead of it
+// while it's suspended are missed, and objects modified ahead of it are seen as modified.
+class ContractSnapshotCursor {
+public:
+    // Where a walk is up to, for resuming it
+    struct Position {
+        uint8_t typeId = 0;
+        uint64_t instance = 0;
+        bool finished = false;
+    };
+
+    ContractSnapshotCursor(const graphene::chain::database& db, uint8_t spaceId, Position start = {})
+        : db(db), spaceId(spaceId), current(start) {}
+
+    // Visit up to maxObjects objects, calling f(const db::object&) for each. Returns false once the walk is finished.
+    template<typename F>
+    bool next(size_t maxObjects, F&& f) {
+        // Bound the probes too, so a chunk over a sparse table takes bounded time even if it finds few objects
+        size_t visited = 0;
+        size_t probes = 0;
+        while (!current.finished && visited < maxObjects && probes < maxObjects * PROBES_PER_OBJECT) {
+            const auto* table = db.find_index(spaceId, current.typeId);
+            if (table == nullptr || current.instance >= table->get_next_id().instance()) {
+                nextTable();
+                continue;
+            }
+
+            ++probes;
+            const auto* object = table->find(graphene::db::object_id_type(spaceId, current.typeId, current.instance));
+            ++current.instance;
+            if (object != nullptr) {
+                f(*object);
+                ++visited;
+            }
+        }
+        return !current.finished;
+    }
+
+    const Position& position() const { return current; }
+    bool finished() const { return current.finished; }
+
+private:
+    constexpr static size_t PROBES_PER_OBJECT = 4;
+
+    const graphene::chain::database& db;
+    const uint8_t spaceId;
+    Position current;
+
+    // Move on to the contract's next table, if it has one
+    void nextTable() {
+        std::optional<uint8_t> nextTypeId;
+        db.inspect_all_indexes(spaceId, [this, &nextTypeId](const graphene::db::index& table) {
+            auto typeId = table.object_type_id();
+            if (typeId > current.typeId && (!nextTypeId.has_value() || typeId < *nextTypeId))
+                nextTypeId = typeId;
+        });
+        if (nextTypeId.has_value()) {
+            current.typeId = *nextTypeId;
+            current.instance = 0;
+        } else {
+            current.finished = true;
+        }
+    }
+};
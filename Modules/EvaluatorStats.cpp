@@ -0,0 +1,81 @@
+#include "EvaluatorStats.hpp"
+
+#include <graphene/protocol/operations.hpp>
+
+namespace {
+struct OperationName {
+    using result_type = std::string;
+    template<typename Operation>
+    std::string operator()(const Operation&) const {
+        std::string name = fc::get_typename<Operation>::name();
+        auto colons = name.rfind("::");
+        return colons == std::string::npos? name : name.substr(colons + 2);
+    }
+};
+
+fc::mutable_variant_object phaseReport(const EvaluatorStats::PhaseStats& stats) {
+    auto totalMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(stats.total).count();
+    return fc::mutable_variant_object("calls", stats.calls)
+            ("exceptions", stats.exceptions)
+            ("totalMicroseconds", totalMicroseconds)
+            ("meanMicroseconds", stats.calls > 0? totalMicroseconds / int64_t(stats.calls) : 0)
+            ("p50Microseconds", stats.percentile(.5))
+            ("p90Microseconds", stats.percentile(.9))
+            ("p99Microseconds", stats.percentile(.99))
+            ("maxMicroseconds", std::chrono::duration_cast<std::chrono::microseconds>(stats.max).count())
+            ("histogram", std::vector<uint64_t>(stats.histogram.begin(), stats.histogram.end()));
+}
+} // namespace
+
+void EvaluatorStats::evaluated(int64_t operationTag, Phase phase, std::chrono::nanoseconds time, bool threw) {
+    auto& stats = operations[operationTag].phase(phase);
+    ++stats.calls;
+    if (threw)
+        ++stats.exceptions;
+    stats.total += time;
+    stats.max = std::max(stats.max, time);
+
+    auto microseconds = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(time).count());
+    size_t bucket = 0;
+    while (microseconds > 0 && bucket < BUCKETS - 1) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    ++stats.histogram[bucket];
+}
+
+uint64_t EvaluatorStats::PhaseStats::percentile(double quantile) const {
+    auto target = uint64_t(quantile * calls);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+        seen += histogram[bucket];
+        if (seen > target)
+            return uint64_t(1) << bucket;
+    }
+    return uint64_t(1) << (BUCKETS - 1);
+}
+
+std::chrono::nanoseconds EvaluatorStats::totalTime() const {
+    std::chrono::nanoseconds total{0};
+    for (const auto& operation : operations)
+        total += operation.second.total();
+    return total;
+}
+
+fc::variant_object EvaluatorStats::report() const {
+    fc::mutable_variant_object byOperation;
+    for (const auto& [tag, stats] : operations)
+        byOperation(operationName(tag), fc::mutable_variant_object("evaluate", phaseReport(stats.evaluate))
+                                                                  ("apply", phaseReport(stats.apply)));
+    return fc::mutable_variant_object("contract", contractName)
+            ("totalMicroseconds", std::chrono::duration_cast<std::chrono::microseconds>(totalTime()).count())
+            ("operations", byOperation);
+}
+
+std::string EvaluatorStats::operationName(int64_t operationTag) {
+    graphene::protocol::operation operation;
+    if (operationTag < 0 || operationTag >= graphene::protocol::operation::count())
+        return std::to_string(operationTag);
+    operation.set_which(operationTag);
+    return operation.visit(OperationName());
+}
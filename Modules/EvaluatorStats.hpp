@@ -0,0 +1,61 @@
+#pragma once
+
+#include <ContractApi.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <array>
+#include <map>
+#include <string>
+
+// Statistics on a contract's evaluators, as reported by their TimedEvaluator wrappers: call counts, exception counts,
+// total time, and a histogram of latencies, per operation type and evaluator phase.
+//
+// The histogram has power-of-two buckets of microseconds: bucket zero counts calls under a microsecond, and bucket i
+// counts calls of at least 2^(i-1) and under 2^i microseconds, with the last bucket counting everything longer.
+// Percentiles are estimated as the upper bound of the bucket they fall in.
+class EvaluatorStats : public EvaluatorObserver {
+public:
+    constexpr static size_t BUCKETS = 24;
+
+    struct PhaseStats {
+        uint64_t calls = 0;
+        uint64_t exceptions = 0;
+        std::chrono::nanoseconds total{0};
+        std::chrono::nanoseconds max{0};
+        std::array<uint64_t, BUCKETS> histogram = {};
+
+        // Estimate a percentile of the latencies, in microseconds
+        uint64_t percentile(double quantile) const;
+    };
+    struct OperationStats {
+        PhaseStats evaluate;
+        // Only operations being applied, rather than just checked, reach this phase
+        PhaseStats apply;
+
+        PhaseStats& phase(Phase p) { return p == Phase::Evaluate? evaluate : apply; }
+        std::chrono::nanoseconds total() const { return evaluate.total + apply.total; }
+    };
+
+    explicit EvaluatorStats(std::string contractName) : contractName(std::move(contractName)) {}
+
+    // EvaluatorObserver interface
+    void evaluated(int64_t operationTag, Phase phase, std::chrono::nanoseconds time, bool threw) override;
+
+    const std::string& getContractName() const { return contractName; }
+    // Get the statistics, by operation tag
+    const std::map<int64_t, OperationStats>& getOperations() const { return operations; }
+    // Total time spent in the contract's evaluators, in both phases
+    std::chrono::nanoseconds totalTime() const;
+    void reset() { operations.clear(); }
+
+    // Get the statistics as a variant, with operations named
+    fc::variant_object report() const;
+
+    // Get the name of an operation type by its tag
+    static std::string operationName(int64_t operationTag);
+
+private:
+    std::string contractName;
+    std::map<int64_t, OperationStats> operations;
+};
@@ -0,0 +1,155 @@
+#include "FieldIndex.hpp"
+
+#include <ContractApi.hpp>
+
+#include <graphene/chain/config.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <limits>
+
+void FieldIndex::setField(const std::string& field, const TableReflection* reflection) {
+    FC_ASSERT(!field.empty(), "[FieldIndex] Field name must not be empty");
+    this->field = field;
+    path.clear();
+    size_t start = 0;
+    while (true) {
+        auto dot = field.find('.', start);
+        path.emplace_back(field.substr(start, dot - start));
+        if (dot == std::string::npos)
+            break;
+        start = dot + 1;
+    }
+
+    // Find the top-level member in the reflection, so objects needn't be converted whole
+    this->reflection = nullptr;
+    if (reflection != nullptr) {
+        for (uint32_t i = 0; i < reflection->fieldCount; ++i) {
+            if (path.front() == reflection->fieldNames[i]) {
+                this->reflection = reflection;
+                reflectedField = i;
+                break;
+            }
+        }
+        if (this->reflection == nullptr)
+            wlog("[FieldIndex] Table ${T} has no reflected field ${F}; indexing it by its variant form",
+                 ("T", reflection->typeId)("F", path.front()));
+    }
+}
+
+// Parse an object ID like "1.2.10", returning nullopt if the string isn't one
+static std::optional<db::object_id_type> parseObjectId(const std::string& text) {
+    uint64_t parts[3] = {};
+    size_t part = 0, digits = 0;
+    for (char c : text) {
+        if (c == '.') {
+            if (digits == 0 || ++part == 3)
+                return std::nullopt;
+            digits = 0;
+        } else if (c >= '0' && c <= '9') {
+            // Instances have 48 bits; anything longer than that is no object ID
+            if (++digits > 15)
+                return std::nullopt;
+            parts[part] = parts[part] * 10 + uint64_t(c - '0');
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (part != 2 || digits == 0 || parts[0] > 0xff || parts[1] > 0xff || parts[2] >= (uint64_t(1) << 48))
+        return std::nullopt;
+    return db::object_id_type(uint8_t(parts[0]), uint8_t(parts[1]), parts[2]);
+}
+
+void FieldIndex::backfill(const db::index& table) {
+    table.inspect_all_objects([this](const db::object& obj) { add(obj); });
+}
+
+FieldIndex::Key FieldIndex::keyOf(const fc::variant& value) {
+    switch (value.get_type()) {
+    case fc::variant::null_type:
+        return std::monostate();
+    case fc::variant::bool_type:
+        return value.as_bool();
+    case fc::variant::int64_type:
+        return value.as_int64();
+    case fc::variant::uint64_type:
+        // Keep integers comparable with each other where their values allow
+        if (value.as_uint64() <= uint64_t(std::numeric_limits<int64_t>::max()))
+            return int64_t(value.as_uint64());
+        return value.as_uint64();
+    case fc::variant::double_type:
+        return value.as_double();
+    case fc::variant::string_type:
+        // Object IDs are strings in variant form; compare them by number, so 1.2.9 comes before 1.2.10
+        if (auto id = parseObjectId(value.get_string()))
+            return *id;
+        return value.get_string();
+    default:
+        return fc::json::to_string(value);
+    }
+}
+
+FieldIndex::Key FieldIndex::extract(const db::object& obj) const {
+    FC_ASSERT(!path.empty(), "[FieldIndex] Field index used before its field was set!");
+    fc::variant value;
+    auto remaining = path.begin();
+    if (reflection != nullptr) {
+        value = reflection->getField(obj, reflectedField, GRAPHENE_MAX_NESTED_OBJECTS);
+        ++remaining;
+    } else {
+        value = obj.to_variant();
+    }
+    for (; remaining != path.end(); ++remaining) {
+        const auto& name = *remaining;
+        if (!value.is_object())
+            return std::monostate();
+        const auto& object = value.get_object();
+        auto itr = object.find(name);
+        if (itr == object.end())
+            return std::monostate();
+        value = itr->value();
+    }
+    return keyOf(value);
+}
+
+void FieldIndex::add(const db::object& obj) {
+    auto key = extract(obj);
+    auto itr = keys.find(obj.id);
+    if (itr != keys.end()) {
+        if (itr->second == key)
+            return;
+        entries.erase({itr->second, obj.id});
+        itr->second = key;
+    } else {
+        keys.emplace(obj.id, key);
+    }
+    entries.emplace(std::move(key), obj.id);
+}
+
+void FieldIndex::remove(const db::object_id_type& id) {
+    auto itr = keys.find(id);
+    if (itr == keys.end())
+        return;
+    entries.erase({itr->second, id});
+    keys.erase(itr);
+}
+
+FieldIndex::Page FieldIndex::range(const Key& lower, const Key& upper, size_t limit,
+                                   const std::optional<Cursor>& after) const {
+    Page page;
+    if (limit == 0 || upper < lower)
+        return page;
+
+    auto itr = entries.lower_bound({lower, db::object_id_type()});
+    if (after.has_value() && lower <= after->key)
+        itr = entries.upper_bound({after->key, after->id});
+
+    for (; itr != entries.end() && !(upper < itr->first); ++itr) {
+        if (page.ids.size() == limit) {
+            page.next = Cursor{std::prev(itr)->first, page.ids.back()};
+            break;
+        }
+        page.ids.push_back(itr->second);
+    }
+    return page;
+}
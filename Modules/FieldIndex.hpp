@@ -0,0 +1,80 @@
+#pragma once
+
+#include <graphene/db/index.hpp>
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace db = graphene::db;
+
+struct TableReflection;
+
+// An ordered index of a table's objects by the value of one of their fields, maintained as a secondary index.
+//
+// The field is named as it appears in the objects' variant form; nested fields are named with dots, like "owner.name".
+// If the table is reflected, only the named top-level field is converted to a variant to find the key; otherwise, the
+// whole object is. Field values are reduced to a comparable key: booleans, integers, floating point numbers, and
+// strings keep their values, object IDs compare by their space, type, and instance numbers, absent or null fields are
+// null, and structured values compare by their JSON. Keys of different kinds order by kind, so a range query only
+// matches values of the kinds of its bounds.
+//
+// Lookups return pages of object IDs in key order, with a cursor to continue from on the next page.
+class FieldIndex : public db::secondary_index {
+public:
+    using Key = std::variant<std::monostate, bool, int64_t, uint64_t, double, db::object_id_type, std::string>;
+
+    // Position of the last result of a page; the next page begins after it
+    struct Cursor {
+        Key key;
+        db::object_id_type id;
+    };
+    struct Page {
+        std::vector<db::object_id_type> ids;
+        // Set if there may be more results
+        std::optional<Cursor> next;
+    };
+
+    // Set the field to index, and the reflection of the table, if it has one. Must be set before the index is used.
+    void setField(const std::string& field, const TableReflection* reflection = nullptr);
+    const std::string& getField() const { return field; }
+
+    // Add the objects already in the table, if any
+    void backfill(const db::index& table);
+
+    // Find objects whose field equals the key
+    Page find(const Key& key, size_t limit, const std::optional<Cursor>& after = {}) const {
+        return range(key, key, limit, after);
+    }
+    // Find objects whose field is between the bounds, inclusive
+    Page range(const Key& lower, const Key& upper, size_t limit, const std::optional<Cursor>& after = {}) const;
+
+    size_t size() const { return keys.size(); }
+
+    // Get the key for a field value
+    static Key keyOf(const fc::variant& value);
+
+    // secondary_index interface
+    void object_loaded(const db::object& obj) override { add(obj); }
+    void object_created(const db::object& obj) override { add(obj); }
+    void object_removed(const db::object& obj) override { remove(obj.id); }
+    void object_modified(const db::object& after) override { add(after); }
+
+private:
+    std::string field;
+    std::vector<std::string> path;
+    // The table's reflection, and the index of the field's top-level member in it, if the table is reflected
+    const TableReflection* reflection = nullptr;
+    uint32_t reflectedField = 0;
+    std::set<std::pair<Key, db::object_id_type>> entries;
+    // Key of each indexed object, so entries can be found without recomputing it
+    std::map<db::object_id_type, Key> keys;
+
+    Key extract(const db::object& obj) const;
+    // Index an object, replacing its old entry if it has one
+    void add(const db::object& obj);
+    void remove(const db::object_id_type& id);
+};
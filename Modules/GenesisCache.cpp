@@ -0,0 +1,69 @@
+#include "GenesisCache.hpp"
+
+#include <graphene/chain/config.hpp>
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <fstream>
+
+GenesisCache::genesis_state_type GenesisCache::load(const fc::path& genesisFile, const fc::path& cacheFile,
+                                                    uint32_t maxDepth) {
+    std::string json;
+    fc::read_file_contents(genesisFile, json);
+    auto contentHash = fc::sha256::hash(json);
+
+    if (fc::is_regular_file(cacheFile)) {
+        try {
+            std::string cache;
+            fc::read_file_contents(cacheFile, cache);
+            fc::datastream<const char*> stream(cache.data(), cache.size());
+            Header header;
+            fc::raw::unpack(stream, header);
+            if (header.magic == MAGIC && header.version == VERSION && header.dbVersion == GRAPHENE_CURRENT_DB_VERSION
+                    && header.contentHash == contentHash) {
+                genesis_state_type genesis;
+                fc::raw::unpack(stream, genesis);
+                dlog("[GenesisCache] Loaded genesis from cache ${C}", ("C", cacheFile));
+                return genesis;
+            }
+            ilog("[GenesisCache] Genesis cache ${C} is out of date; rebuilding it", ("C", cacheFile));
+        } catch (const fc::exception& e) {
+            wlog("[GenesisCache] Could not read genesis cache ${C}; rebuilding it: ${E}",
+                 ("C", cacheFile)("E", e.to_string()));
+        }
+    }
+
+    auto genesis = fc::json::from_string(json).as<genesis_state_type>(maxDepth);
+    // The chain ID is the hash of the genesis as we serialize it, not as the file has it
+    genesis.initial_chain_id = fc::sha256::hash(fc::json::to_string(genesis) + "\n");
+
+    try {
+        store(cacheFile, json, genesis);
+    } catch (const fc::exception& e) {
+        wlog("[GenesisCache] Could not write genesis cache ${C}: ${E}", ("C", cacheFile)("E", e.to_string()));
+    }
+    return genesis;
+}
+
+void GenesisCache::store(const fc::path& cacheFile, const std::string& json, const genesis_state_type& genesis) {
+    Header header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.dbVersion = GRAPHENE_CURRENT_DB_VERSION;
+    header.contentHash = fc::sha256::hash(json);
+    auto headerBytes = fc::raw::pack(header);
+    auto genesisBytes = fc::raw::pack(genesis);
+
+    // Write to a temporary file and rename it, so a reader never sees a partial cache
+    fc::path temporary(cacheFile.string() + ".partial");
+    {
+        std::ofstream out(temporary.string(), std::ios::binary | std::ios::trunc);
+        out.write(headerBytes.data(), headerBytes.size());
+        out.write(genesisBytes.data(), genesisBytes.size());
+        FC_ASSERT(out.good(), "[GenesisCache] Failed to write ${P}", ("P", temporary));
+    }
+    fc::rename(temporary, cacheFile);
+}
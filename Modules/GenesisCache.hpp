@@ -0,0 +1,37 @@
+#pragma once
+
+#include <graphene/chain/genesis_state.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+
+#include <string>
+
+// A binary cache of a genesis JSON file, so the chain can be opened without parsing the JSON every time.
+//
+// The cache holds the packed genesis with its chain ID already computed, keyed by a hash of the JSON file's contents
+// and by the version of the chain database the genesis structure belongs to. A cache that doesn't match the file, or
+// can't be read at all, is ignored and rebuilt from the JSON.
+class GenesisCache {
+public:
+    using genesis_state_type = graphene::chain::genesis_state_type;
+
+    // Load the genesis from its JSON file, or from the cache if it matches the file. The file is read once, and on a
+    // cache miss the genesis is parsed from the same buffer and the cache is rewritten.
+    static genesis_state_type load(const fc::path& genesisFile, const fc::path& cacheFile, uint32_t maxDepth);
+    // Store a genesis in the cache, as parsed from the given JSON. Its chain ID must already be set.
+    static void store(const fc::path& cacheFile, const std::string& json, const genesis_state_type& genesis);
+
+    struct Header {
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        std::string dbVersion;
+        fc::sha256 contentHash;
+    };
+
+private:
+    constexpr static uint32_t MAGIC = 0x4E454750; // "PGEN"
+    constexpr static uint32_t VERSION = 1;
+};
+
+FC_REFLECT(GenesisCache::Header, (magic)(version)(dbVersion)(contentHash))
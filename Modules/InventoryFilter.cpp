@@ -0,0 +1,43 @@
+#include "InventoryFilter.hpp"
+
+InventoryFilter::InventoryFilter(uint32_t headBlockNum, size_t itemsPerGeneration, double falsePositiveRate,
+                                 Clock::duration generationSpan, Clock::duration transactionHorizon)
+    : filter(itemsPerGeneration, falsePositiveRate, generationSpan), transactionHorizon(transactionHorizon),
+      coverageFloorBlockNum(headBlockNum), generationFloorBlockNum(headBlockNum) {}
+
+void InventoryFilter::blockSeen(const graphene::protocol::block_id_type& blockId, uint32_t headBlockNum) {
+    rotateIfDue(headBlockNum);
+    filter.insert(blockId.data(), blockId.data_size());
+}
+
+void InventoryFilter::transactionSeen(const graphene::net::message_hash_type& messageId, uint32_t headBlockNum) {
+    rotateIfDue(headBlockNum);
+    filter.insert(messageId.data(), messageId.data_size());
+}
+
+InventoryFilter::Answer InventoryFilter::check(const graphene::net::item_id& id) {
+    bool covered = false;
+    if (id.item_type == graphene::net::block_message_type)
+        covered = graphene::protocol::block_header::num_from_id(id.item_hash) > coverageFloorBlockNum;
+    else if (id.item_type == graphene::net::trx_message_type)
+        covered = Clock::now() - filter.coverageStart() >= transactionHorizon;
+
+    if (!covered) {
+        ++counters.notCovered;
+        return Answer::NotCovered;
+    }
+    if (!filter.mayContain(id.item_hash.data(), id.item_hash.data_size())) {
+        ++counters.unseen;
+        return Answer::Unseen;
+    }
+    ++counters.maybeSeen;
+    return Answer::MaybeSeen;
+}
+
+void InventoryFilter::rotateIfDue(uint32_t headBlockNum) {
+    if (filter.rotateIfDue()) {
+        // The oldest generation now is the one that began at the last rotation
+        coverageFloorBlockNum = generationFloorBlockNum;
+        generationFloorBlockNum = headBlockNum;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "RotatingBloomFilter.hpp"
+
+#include <graphene/net/core_messages.hpp>
+
+// A fast filter in front of has_item lookups, which answers "definitely unseen" for most inventory we don't have.
+//
+// Every block and transaction the node receives is recorded in a RotatingBloomFilter. Only blocks numbered after the
+// head block at the start of the filter's coverage can have been received within that coverage, so older blocks are
+// left to the database. Transactions are only filtered once the filter's coverage spans the transaction horizon, the
+// period within which a transaction we've seen may still be asked about.
+class InventoryFilter {
+public:
+    using Clock = RotatingBloomFilter::Clock;
+
+    enum class Answer {
+        // The item was definitely not seen; no lookup is needed
+        Unseen,
+        // The item may have been seen; a lookup is needed, and its outcome should be reported via recordLookup()
+        MaybeSeen,
+        // The filter doesn't cover this item; a lookup is needed
+        NotCovered
+    };
+
+    struct Counters {
+        // Queries answered Unseen, MaybeSeen, and NotCovered, respectively
+        uint64_t unseen = 0;
+        uint64_t maybeSeen = 0;
+        uint64_t notCovered = 0;
+        // MaybeSeen answers where the lookup found that we didn't have the item after all
+        uint64_t falsePositives = 0;
+
+        // Observed fraction of unseen items which the filter failed to rule out
+        double falsePositiveRate() const {
+            auto negatives = unseen + falsePositives;
+            return negatives == 0? 0 : double(falsePositives) / negatives;
+        }
+    };
+
+    InventoryFilter(uint32_t headBlockNum, size_t itemsPerGeneration = 1000000, double falsePositiveRate = .01,
+                    Clock::duration generationSpan = std::chrono::hours(1),
+                    Clock::duration transactionHorizon = std::chrono::hours(1));
+
+    // Record a block we've received or applied
+    void blockSeen(const graphene::protocol::block_id_type& blockId, uint32_t headBlockNum);
+    // Record a transaction we've received, by message ID
+    void transactionSeen(const graphene::net::message_hash_type& messageId, uint32_t headBlockNum);
+
+    // Check whether an item may have been seen
+    Answer check(const graphene::net::item_id& id);
+    // Report the outcome of the lookup following a MaybeSeen answer
+    void recordLookup(bool found) { if (!found) ++counters.falsePositives; }
+
+    const Counters& getCounters() const { return counters; }
+
+private:
+    RotatingBloomFilter filter;
+    const Clock::duration transactionHorizon;
+    // Blocks after this number were received within the filter's coverage
+    uint32_t coverageFloorBlockNum;
+    // Head block number when the filter's current generation began
+    uint32_t generationFloorBlockNum;
+    Counters counters;
+
+    void rotateIfDue(uint32_t headBlockNum);
+};
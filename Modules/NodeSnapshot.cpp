@@ -0,0 +1,219 @@
+#include "NodeSnapshot.hpp"
+
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+constexpr size_t BUFFER_SIZE = 1 << 20;
+
+// Hash size bytes of a stream from its current position, copying them to out if it's provided
+fc::sha256 hashAndCopy(std::istream& in, uint64_t size, std::ostream* out) {
+    fc::sha256::encoder encoder;
+    std::vector<char> buffer(std::min<uint64_t>(size, BUFFER_SIZE));
+    while (size > 0) {
+        auto chunk = std::min<uint64_t>(size, buffer.size());
+        in.read(buffer.data(), chunk);
+        FC_ASSERT(in.gcount() == std::streamsize(chunk), "[NodeSnapshot] Unexpected end of file");
+        encoder.write(buffer.data(), chunk);
+        if (out != nullptr)
+            out->write(buffer.data(), chunk);
+        size -= chunk;
+    }
+    if (out != nullptr)
+        FC_ASSERT(out->good(), "[NodeSnapshot] Failed to write file");
+    return encoder.result();
+}
+
+// Read a snapshot's manifest, and get the offset at which its sections begin
+NodeSnapshot::Manifest readManifest(std::istream& in, uint32_t magic, uint32_t version, uint64_t& dataStart) {
+    in.seekg(0, std::ios::end);
+    uint64_t fileSize = in.tellg();
+    in.seekg(0);
+
+    uint32_t header[2] = {};
+    uint64_t manifestSize = 0;
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.read(reinterpret_cast<char*>(&manifestSize), sizeof(manifestSize));
+    FC_ASSERT(in.good() && header[0] == magic, "[NodeSnapshot] File is not a snapshot");
+    FC_ASSERT(header[1] == version, "[NodeSnapshot] Snapshot version ${V} is not supported", ("V", header[1]));
+    // Check the size against the file before allocating for it, so a damaged size fails cleanly
+    FC_ASSERT(manifestSize <= fileSize - sizeof(header) - sizeof(manifestSize),
+              "[NodeSnapshot] Snapshot manifest size ${M} exceeds the file size ${F}",
+              ("M", manifestSize)("F", fileSize));
+
+    std::vector<char> manifest(manifestSize);
+    in.read(manifest.data(), manifest.size());
+    FC_ASSERT(in.gcount() == std::streamsize(manifest.size()), "[NodeSnapshot] Snapshot manifest is truncated");
+    dataStart = sizeof(header) + sizeof(manifestSize) + manifestSize;
+    return fc::raw::unpack<NodeSnapshot::Manifest>(manifest);
+}
+} // namespace
+
+NodeSnapshot::Manifest NodeSnapshot::write(const fc::path& snapshotFile, const fc::path& basePath,
+                                           const std::vector<std::string>& files,
+                                           const graphene::protocol::signed_block& headBlock,
+                                           const graphene::protocol::chain_id_type& chainId,
+                                           std::vector<Contract> contracts, WorkerPool& workers) {
+    Manifest manifest;
+    manifest.headBlockNum = headBlock.block_num();
+    manifest.headBlockId = headBlock.id();
+    manifest.chainId = chainId;
+    manifest.created = fc::time_point::now();
+    manifest.contracts = std::move(contracts);
+
+    // Lay out the sections, hashing the files in parallel
+    uint64_t offset = 0;
+    std::vector<fc::future<fc::sha256>> checksums;
+    for (const auto& file : files) {
+        auto path = basePath / file;
+        auto size = fc::file_size(path);
+        manifest.sections.push_back({uint8_t(SectionKind::File), file, offset, size, {}});
+        offset += size;
+        checksums.emplace_back(workers.run([path, size] {
+            std::ifstream in(path.string(), std::ios::binary);
+            return hashAndCopy(in, size, nullptr);
+        }, "Snapshot checksum"));
+    }
+    auto headBytes = fc::raw::pack(headBlock);
+    manifest.sections.push_back({uint8_t(SectionKind::HeadBlock), std::string(), offset, headBytes.size(),
+                                 fc::sha256::hash(headBytes.data(), headBytes.size())});
+    for (size_t i = 0; i < checksums.size(); ++i)
+        manifest.sections[i].checksum = checksums[i].wait();
+
+    // Write to a temporary file, and only replace any existing snapshot once the new one is complete. The manifest and
+    // head block are written here; the files are copied into their sections in parallel, off this thread.
+    fc::path temporary(snapshotFile.string() + ".partial");
+    uint64_t dataStart = 0;
+    {
+        std::ofstream out(temporary.string(), std::ios::binary | std::ios::trunc);
+        auto manifestBytes = fc::raw::pack(manifest);
+        uint32_t header[2] = {MAGIC, VERSION};
+        uint64_t manifestSize = manifestBytes.size();
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&manifestSize), sizeof(manifestSize));
+        out.write(manifestBytes.data(), manifestBytes.size());
+        dataStart = out.tellp();
+        out.seekp(dataStart + manifest.sections.back().offset);
+        out.write(headBytes.data(), headBytes.size());
+        FC_ASSERT(out.good(), "[NodeSnapshot] Failed to write snapshot to ${P}", ("P", temporary));
+    }
+
+    std::vector<fc::future<void>> copies;
+    for (size_t i = 0; i < files.size(); ++i) {
+        copies.emplace_back(workers.run([source = basePath / files[i], section = manifest.sections[i], temporary,
+                                         start = dataStart + manifest.sections[i].offset] {
+            std::ifstream in(source.string(), std::ios::binary);
+            std::fstream out(temporary.string(), std::ios::binary | std::ios::in | std::ios::out);
+            out.seekp(start);
+            // Copying hashes the file again, which catches any file that changed since it was hashed
+            auto checksum = hashAndCopy(in, section.size, &out);
+            FC_ASSERT(checksum == section.checksum,
+                      "[NodeSnapshot] File ${F} changed while the snapshot was being written", ("F", section.path));
+        }, "Snapshot copy"));
+    }
+
+    std::optional<fc::exception> failure;
+    for (auto& copy : copies) {
+        try {
+            copy.wait();
+        } catch (const fc::exception& e) {
+            if (!failure)
+                failure = e;
+        }
+    }
+    if (failure) {
+        fc::remove(temporary);
+        throw *failure;
+    }
+    fc::rename(temporary, snapshotFile);
+
+    return manifest;
+}
+
+NodeSnapshot::Manifest NodeSnapshot::readManifest(const fc::path& snapshotFile) {
+    std::ifstream in(snapshotFile.string(), std::ios::binary);
+    FC_ASSERT(in.good(), "[NodeSnapshot] Could not open snapshot ${P}", ("P", snapshotFile));
+    uint64_t dataStart = 0;
+    return ::readManifest(in, MAGIC, VERSION, dataStart);
+}
+
+NodeSnapshot::Restored NodeSnapshot::restore(const fc::path& snapshotFile, const fc::path& basePath,
+                                             WorkerPool& workers) {
+    Restored restored;
+    uint64_t dataStart = 0;
+    {
+        std::ifstream in(snapshotFile.string(), std::ios::binary);
+        FC_ASSERT(in.good(), "[NodeSnapshot] Could not open snapshot ${P}", ("P", snapshotFile));
+        restored.manifest = ::readManifest(in, MAGIC, VERSION, dataStart);
+    }
+
+    // Restore the files to temporary paths in parallel, verifying each one's checksum as it's copied
+    std::vector<std::pair<fc::path, fc::path>> restoredFiles;
+    std::vector<fc::future<void>> tasks;
+    std::optional<Section> headSection;
+    for (const auto& section : restored.manifest.sections) {
+        if (section.kind == uint8_t(SectionKind::HeadBlock)) {
+            headSection = section;
+            continue;
+        }
+        FC_ASSERT(section.kind == uint8_t(SectionKind::File), "[NodeSnapshot] Unknown section kind ${K}",
+                  ("K", section.kind));
+        fc::path relative(section.path);
+        FC_ASSERT(!relative.is_absolute() && section.path.find("..") == std::string::npos,
+                  "[NodeSnapshot] Snapshot contains a file outside the configuration directory: ${P}",
+                  ("P", section.path));
+
+        auto target = basePath / relative;
+        fc::path temporary(target.string() + ".partial");
+        fc::create_directories(target.parent_path());
+        restoredFiles.emplace_back(temporary, target);
+        tasks.emplace_back(workers.run([snapshotFile, section, temporary, start = dataStart + section.offset] {
+            std::ifstream in(snapshotFile.string(), std::ios::binary);
+            in.seekg(start);
+            std::ofstream out(temporary.string(), std::ios::binary | std::ios::trunc);
+            auto checksum = hashAndCopy(in, section.size, &out);
+            FC_ASSERT(checksum == section.checksum, "[NodeSnapshot] Checksum mismatch in snapshot file ${F}",
+                      ("F", section.path));
+        }, "Snapshot restore"));
+    }
+
+    std::optional<fc::exception> failure;
+    for (auto& task : tasks) {
+        try {
+            task.wait();
+        } catch (const fc::exception& e) {
+            if (!failure)
+                failure = e;
+        }
+    }
+
+    try {
+        FC_ASSERT(headSection.has_value(), "[NodeSnapshot] Snapshot has no head block");
+        std::ifstream in(snapshotFile.string(), std::ios::binary);
+        in.seekg(dataStart + headSection->offset);
+        std::vector<char> headBytes(headSection->size);
+        in.read(headBytes.data(), headBytes.size());
+        FC_ASSERT(in.gcount() == std::streamsize(headBytes.size()) &&
+                  fc::sha256::hash(headBytes.data(), headBytes.size()) == headSection->checksum,
+                  "[NodeSnapshot] Checksum mismatch in snapshot head block");
+        restored.headBlock = fc::raw::unpack<graphene::protocol::signed_block>(headBytes);
+        FC_ASSERT(restored.headBlock.id() == restored.manifest.headBlockId,
+                  "[NodeSnapshot] Snapshot head block does not match its manifest");
+    } catch (const fc::exception& e) {
+        if (!failure)
+            failure = e;
+    }
+
+    if (failure) {
+        for (const auto& file : restoredFiles)
+            if (fc::exists(file.first))
+                fc::remove(file.first);
+        throw *failure;
+    }
+    for (const auto& [temporary, target] : restoredFiles)
+        fc::rename(temporary, target);
+    return restored;
+}
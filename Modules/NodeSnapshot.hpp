@@ -0,0 +1,79 @@
+#pragma once
+
+#include "WorkerPool.hpp"
+
+#include <graphene/protocol/block.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// A binary snapshot of a node's state at a block, so that a new node can start from it instead of syncing and replaying
+// the whole chain.
+//
+// A snapshot holds the files of the node's databases, as flushed at the snapshot block: the chain's object database,
+// which includes every contract's database, the node's persistence database with its records of contract space
+// assignments, and the genesis the chain was created from. It also holds the snapshot block itself, which becomes the
+// restored chain's head. Blocks before it are not included.
+//
+// The file begins with a magic number, a version, and the size of the manifest, followed by the packed manifest and
+// then the sections' contents. Each section has a SHA-256 checksum. Sections are hashed, written, and restored in
+// parallel on a worker pool.
+class NodeSnapshot {
+public:
+    enum class SectionKind : uint8_t {
+        // A file to restore, at a path relative to the node's configuration directory
+        File,
+        // The packed head block
+        HeadBlock
+    };
+    struct Section {
+        uint8_t kind = 0;
+        std::string path;
+        // Offset of the section's contents from the end of the manifest, and their size
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        fc::sha256 checksum;
+    };
+    struct Contract {
+        uint8_t spaceId = 0;
+        std::string name;
+    };
+    struct Manifest {
+        uint32_t headBlockNum = 0;
+        graphene::protocol::block_id_type headBlockId;
+        graphene::protocol::chain_id_type chainId;
+        fc::time_point_sec created;
+        // The contracts which had been assigned spaces as of the snapshot
+        std::vector<Contract> contracts;
+        std::vector<Section> sections;
+    };
+
+    struct Restored {
+        Manifest manifest;
+        graphene::protocol::signed_block headBlock;
+    };
+
+    // Write a snapshot. The files are given as paths relative to basePath, and must not change while being written.
+    static Manifest write(const fc::path& snapshotFile, const fc::path& basePath, const std::vector<std::string>& files,
+                          const graphene::protocol::signed_block& headBlock,
+                          const graphene::protocol::chain_id_type& chainId, std::vector<Contract> contracts,
+                          WorkerPool& workers);
+    // Read the manifest of a snapshot
+    static Manifest readManifest(const fc::path& snapshotFile);
+    // Restore a snapshot's files under basePath, verifying their checksums, and return its head block. Files are only
+    // put in place once every section has been verified; if any fails, nothing is restored and an exception is thrown.
+    static Restored restore(const fc::path& snapshotFile, const fc::path& basePath, WorkerPool& workers);
+
+private:
+    constexpr static uint32_t MAGIC = 0x534E4350; // "PCNS"
+    constexpr static uint32_t VERSION = 1;
+};
+
+FC_REFLECT(NodeSnapshot::Section, (kind)(path)(offset)(size)(checksum))
+FC_REFLECT(NodeSnapshot::Contract, (spaceId)(name))
+FC_REFLECT(NodeSnapshot::Manifest, (headBlockNum)(headBlockId)(chainId)(created)(contracts)(sections))
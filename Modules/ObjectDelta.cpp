@@ -0,0 +1,108 @@
+#include "ObjectDelta.hpp"
+
+#include <ContractApi.hpp>
+
+#include <fc/io/raw_variant.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+
+// Differing runs of bytes separated by fewer equal bytes than this are merged into one segment, as a segment's own
+// overhead would outweigh the bytes saved
+constexpr static size_t MERGE_GAP = 4;
+
+std::optional<ObjectDelta> ObjectDelta::compute(const std::vector<char>& before, const std::vector<char>& after) {
+    if (before == after)
+        return std::nullopt;
+
+    ObjectDelta delta;
+    delta.priorSize = before.size();
+
+    // Skip the common prefix and suffix
+    auto shorter = std::min(before.size(), after.size());
+    size_t prefix = 0;
+    while (prefix < shorter && before[prefix] == after[prefix])
+        ++prefix;
+    size_t suffix = 0;
+    while (suffix < shorter - prefix && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix])
+        ++suffix;
+
+    if (before.size() != after.size()) {
+        // The layout shifted, so there's no telling which bytes correspond; replace the whole middle
+        delta.segments.push_back({prefix, before.size() - prefix - suffix,
+                                  std::vector<char>(after.begin() + prefix, after.end() - suffix)});
+        return delta;
+    }
+
+    // Same layout: record each run of differing bytes
+    size_t end = before.size() - suffix;
+    size_t position = prefix;
+    while (position < end) {
+        size_t runStart = position;
+        size_t runEnd = position + 1;
+        size_t equal = 0;
+        for (size_t i = runEnd; i < end && equal < MERGE_GAP; ++i) {
+            if (before[i] == after[i]) {
+                ++equal;
+            } else {
+                equal = 0;
+                runEnd = i + 1;
+            }
+        }
+        delta.segments.push_back({runStart, runEnd - runStart,
+                                  std::vector<char>(after.begin() + runStart, after.begin() + runEnd)});
+
+        position = runEnd;
+        while (position < end && before[position] == after[position])
+            ++position;
+    }
+
+    return delta;
+}
+
+std::vector<char> ObjectDelta::apply(const std::vector<char>& before) const {
+    FC_ASSERT(before.size() == priorSize.value, "[ObjectDelta] Delta does not apply to a state of this size",
+              ("Expected", priorSize.value)("Actual", before.size()));
+
+    std::vector<char> after;
+    after.reserve(before.size());
+    size_t position = 0;
+    for (const auto& segment : segments) {
+        FC_ASSERT(segment.offset.value >= position && segment.offset.value + segment.removed.value <= before.size(),
+                  "[ObjectDelta] Malformed delta");
+        after.insert(after.end(), before.begin() + position, before.begin() + segment.offset.value);
+        after.insert(after.end(), segment.inserted.begin(), segment.inserted.end());
+        position = segment.offset.value + segment.removed.value;
+    }
+    after.insert(after.end(), before.begin() + position, before.end());
+    return after;
+}
+
+fc::variant_object ObjectDelta::fieldChanges(const TableReflection& reflection, const graphene::db::object& before,
+                                             const graphene::db::object& after, uint32_t maxDepth) {
+    fc::mutable_variant_object changes;
+    for (uint32_t field = 0; field < reflection.fieldCount; ++field)
+        if (reflection.fieldDiffers(before, after, field))
+            changes(reflection.fieldNames[field],
+                    fc::mutable_variant_object("from", reflection.getField(before, field, maxDepth))
+                                              ("to", reflection.getField(after, field, maxDepth)));
+    return changes;
+}
+
+fc::variant_object ObjectDelta::fieldChanges(const fc::variant_object& before, const fc::variant_object& after) {
+    // Variants of structured values can't be compared directly, so compare their packed forms
+    auto differ = [](const fc::variant& a, const fc::variant& b) { return fc::raw::pack(a) != fc::raw::pack(b); };
+
+    fc::mutable_variant_object changes;
+    for (const auto& field : after) {
+        auto prior = before.find(field.key());
+        if (prior == before.end())
+            changes(field.key(), fc::mutable_variant_object("from", fc::variant())("to", field.value()));
+        else if (differ(prior->value(), field.value()))
+            changes(field.key(), fc::mutable_variant_object("from", prior->value())("to", field.value()));
+    }
+    for (const auto& field : before)
+        if (!after.contains(field.key().c_str()))
+            changes(field.key(), fc::mutable_variant_object("from", field.value())("to", fc::variant()));
+    return changes;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant_object.hpp>
+
+#include <optional>
+#include <vector>
+
+namespace graphene { namespace db { class object; } }
+struct TableReflection;
+
+// A compact, binary description of how a modification changed an object.
+//
+// Objects are compared in their packed form, and the delta records only the byte ranges which differ: each segment
+// replaces a run of bytes in the prior state with new bytes. A modification which changes one counter in a large object
+// thus yields a delta of a few bytes. Objects whose packed forms are identical have no delta at all.
+//
+// Deltas are meant for compact transport and storage. For display, fieldChanges() gives the changed fields by name.
+struct ObjectDelta {
+    struct Segment {
+        // Offset in the prior state at which the segment applies
+        fc::unsigned_int offset;
+        // Number of bytes of the prior state to replace
+        fc::unsigned_int removed;
+        // Bytes to replace them with
+        std::vector<char> inserted;
+    };
+
+    // Size of the packed prior state the delta applies to
+    fc::unsigned_int priorSize;
+    std::vector<Segment> segments;
+
+    // Compute the delta between two packed states of an object. Returns nullopt if they're identical.
+    static std::optional<ObjectDelta> compute(const std::vector<char>& before, const std::vector<char>& after);
+    // Apply the delta to the packed prior state, returning the packed new state
+    std::vector<char> apply(const std::vector<char>& before) const;
+    // Size of the delta when packed
+    size_t packedSize() const { return fc::raw::pack_size(*this); }
+
+    // Get the fields which differ between two states of an object, like {"field": {"from": x, "to": y}}, comparing
+    // the fields by the reflection of the object's table. Only the changed fields are converted to variants.
+    static fc::variant_object fieldChanges(const TableReflection& reflection, const graphene::db::object& before,
+                                           const graphene::db::object& after, uint32_t maxDepth);
+    // Get the fields which differ between two variant forms of an object, for tables without a reflection
+    static fc::variant_object fieldChanges(const fc::variant_object& before, const fc::variant_object& after);
+};
+
+FC_REFLECT(ObjectDelta::Segment, (offset)(removed)(inserted))
+FC_REFLECT(ObjectDelta, (priorSize)(segments))
@@ -7,33 +7,60 @@
 
 #include <boost/range/adaptor/reversed.hpp>
 #include <boost/range/algorithm/reverse.hpp>
-#include <boost/range/algorithm/transform.hpp>
+
+#include <algorithm>
 
 bool P2pHandler::NodeInterface::blockIsInOurChain(graphene::protocol::block_id_type id) {
     uint32_t block_num = Chain::block_header::num_from_id(id);
-    Chain::block_id_type block_id_in_preferred_chain = handler.db.get_block_id_for_num(block_num);
+    Chain::block_id_type block_id_in_preferred_chain = blockIdForNum(block_num);
     return id == block_id_in_preferred_chain;
 }
 
+Chain::block_id_type P2pHandler::NodeInterface::blockIdForNum(uint32_t blockNum) {
+    // The chain doesn't tell us when it pops blocks, so drop any IDs above its head before trusting the index
+    handler.blockIds.truncate(handler.db.head_block_num());
+    if (auto id = handler.blockIds.find(blockNum))
+        return *id;
+    return handler.db.get_block_id_for_num(blockNum);
+}
+
 P2pHandler::NodeInterface::NodeInterface(P2pHandler& handler) : handler(handler) {}
 
 bool P2pHandler::NodeInterface::has_item(const Net::item_id& id) {
+    // The pool may hold transactions for longer than the filter remembers them, so check it first
+    if (id.item_type == Net::trx_message_type && handler.transactionPool.contains(id.item_hash))
+        return true;
+
+    auto filterAnswer = handler.inventoryFilter.check(id);
+    if (filterAnswer == InventoryFilter::Answer::Unseen)
+        return false;
+
+    bool known = false;
     if (id.item_type == Net::block_message_type)
-        return handler.db.is_known_block(id.item_hash);
+        known = handler.db.is_known_block(id.item_hash);
     else if (id.item_type == Net::trx_message_type)
-        return handler.db.is_known_transaction(id.item_hash);
+        known = handler.transactionIds.contains(id.item_hash) || handler.db.is_known_transaction(id.item_hash);
     else {
         elog("net::node asked if we recognize ID of unkown type: ${id}", ("id", id));
         return false;
     }
+
+    if (filterAnswer == InventoryFilter::Answer::MaybeSeen)
+        handler.inventoryFilter.recordLookup(known);
+    return known;
 }
 
 bool P2pHandler::NodeInterface::handle_block(const Net::block_message& blk_msg, bool sync_mode, std::vector<fc::uint160_t>& contained_transaction_message_ids) {
-    handler.blockReceived(blk_msg.block);
+    const auto& trxIds = handler.transactionIds.blockTransactionIds(blk_msg.block);
+    contained_transaction_message_ids.assign(trxIds.begin(), trxIds.end());
+
+    auto headBlockNum = handler.db.head_block_num();
+    handler.inventoryFilter.blockSeen(blk_msg.block_id, headBlockNum);
+    for (const auto& trxId : trxIds)
+        handler.inventoryFilter.transactionSeen(trxId, headBlockNum);
 
-    contained_transaction_message_ids.clear();
-    boost::transform(blk_msg.block.transactions, std::back_inserter(contained_transaction_message_ids),
-                     [](const Chain::signed_transaction& trx) { return Net::message(Net::trx_message(trx)).id(); });
+    // Hand the block to the pipeline; this waits if the pipeline is full, slowing net::node down to our pace
+    handler.pipeline.submit(blk_msg.block, handler.db.get_chain_id());
 
     if (!sync_mode && handler.syncing) {
         handler.syncing = false;
@@ -45,7 +72,12 @@ bool P2pHandler::NodeInterface::handle_block(const Net::block_message& blk_msg,
 }
 
 void P2pHandler::NodeInterface::handle_transaction(const Net::trx_message& trx_msg) {
-    handler.transactionReceived(trx_msg.trx);
+    // Only pass on transactions we haven't already seen
+    auto messageId = TransactionIdCache::computeMessageId(trx_msg.trx);
+    if (handler.transactionPool.add(trx_msg.trx, messageId, handler.db.head_block_time())) {
+        handler.inventoryFilter.transactionSeen(messageId, handler.db.head_block_num());
+        handler.transactionReceived(trx_msg.trx);
+    }
 }
 
 void P2pHandler::NodeInterface::handle_message(const Net::message& message_to_process) {
@@ -84,25 +116,50 @@ std::vector<Net::item_hash_t> P2pHandler::NodeInterface::get_block_ids(const std
       if (!found_a_block_in_synopsis)
         FC_THROW_EXCEPTION(graphene::net::peer_is_on_an_unreachable_fork, "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis");
     }
-    for( uint32_t num = Chain::block_header::num_from_id(last_known_block_id);
-         num <= handler.db.head_block_num() && result.size() < limit;
-         ++num )
-       if( num > 0 )
-          result.push_back(handler.db.get_block_id_for_num(num));
+    uint32_t first_block_num = std::max(Chain::block_header::num_from_id(last_known_block_id), 1u);
+    uint32_t last_block_num = handler.db.head_block_num();
+    if (limit > 0 && first_block_num <= last_block_num) {
+        last_block_num = std::min<uint64_t>(last_block_num, uint64_t(first_block_num) + limit - 1);
+        // Copy the IDs straight out of the index if we can; otherwise, look them up one at a time
+        handler.blockIds.truncate(handler.db.head_block_num());
+        if (!handler.blockIds.copyRange(first_block_num, last_block_num, result))
+            for (uint32_t num = first_block_num; num <= last_block_num; ++num)
+                result.push_back(blockIdForNum(num));
+    }
 
     if( !result.empty() && Chain::block_header::num_from_id(result.back()) < handler.db.head_block_num() )
        remaining_item_count = handler.db.head_block_num() - Chain::block_header::num_from_id(result.back());
 
+    handler.syncTracker.peerRemainingItems(remaining_item_count);
+
     return result;
 }
 
 Net::message P2pHandler::NodeInterface::get_item(const Net::item_id& id) {
     if (id.item_type == Net::block_message_type) {
+        if (auto cached = handler.blockMessages.find(id.item_hash))
+            return *cached;
         auto found = handler.db.fetch_block_by_id(id.item_hash);
         FC_ASSERT(found, "Could not find requested block ${id}", ("id", id.item_hash));
-        return Net::block_message(*found);
-    } else if (id.item_type == Net::trx_message_type)
-        return Net::trx_message(handler.db.get_recent_transaction(id.item_hash));
+        return handler.blockMessages.insert(*found);
+    } else if (id.item_type == Net::trx_message_type) {
+        if (auto trx = handler.transactionPool.find(id.item_hash))
+            return Net::trx_message(*trx);
+        if (handler.db.is_known_transaction(id.item_hash))
+            return Net::trx_message(handler.db.get_recent_transaction(id.item_hash));
+        // If it's in a block we received recently, serve it from that block, preferring the cached message to the disk
+        if (auto location = handler.transactionIds.find(id.item_hash)) {
+            fc::optional<Chain::signed_block> block;
+            if (auto cached = handler.blockMessages.find(location->blockId))
+                block = cached->as<Net::block_message>().block;
+            else
+                block = handler.db.fetch_block_by_id(location->blockId);
+            if (block && block->transactions.size() > location->index)
+                return Net::trx_message(block->transactions[location->index]);
+        }
+        FC_THROW_EXCEPTION(fc::key_not_found_exception, "Could not find requested transaction ${id}",
+                           ("id", id.item_hash));
+    }
 
     elog("net::node asked for item with ID of unkown type: ${id}", ("id", id));
     FC_THROW_EXCEPTION(fc::assert_exception, "Unknown message type ${type}", ("type", id.item_type));
@@ -220,7 +277,7 @@ P2pHandler::NodeInterface::get_blockchain_synopsis(const Net::item_hash_t& refer
         // if it's <= non_fork_high_block_num, we grab it from the main blockchain;
         // if it's not, we pull it from the fork history
         if (low_block_num <= non_fork_high_block_num)
-            synopsis.push_back(handler.db.get_block_id_for_num(low_block_num));
+            synopsis.push_back(blockIdForNum(low_block_num));
         else
             synopsis.push_back(fork_history[low_block_num - non_fork_high_block_num - 1]);
         low_block_num += (true_high_block_num - low_block_num + 2) / 2;
@@ -230,12 +287,13 @@ P2pHandler::NodeInterface::get_blockchain_synopsis(const Net::item_hash_t& refer
     return synopsis;
 }
 
-void P2pHandler::NodeInterface::sync_status(uint32_t, uint32_t) {
-    // *shrug* Maybe use this eventually
+void P2pHandler::NodeInterface::sync_status(uint32_t item_type, uint32_t item_count) {
+    if (item_type == Net::block_message_type)
+        handler.syncTracker.syncStatus(item_count);
 }
 
-void P2pHandler::NodeInterface::connection_count_changed(uint32_t) {
-    // *shrug* Maybe use this eventually
+void P2pHandler::NodeInterface::connection_count_changed(uint32_t c) {
+    handler.syncTracker.connectionCountChanged(c);
 }
 
 uint32_t P2pHandler::NodeInterface::get_block_number(const Net::item_hash_t& block_id) {
@@ -243,6 +301,10 @@ uint32_t P2pHandler::NodeInterface::get_block_number(const Net::item_hash_t& blo
 }
 
 fc::time_point_sec P2pHandler::NodeInterface::get_block_time(const Net::item_hash_t& block_id) {
+    if (handler.headerIndex != nullptr)
+        if (auto header = handler.headerIndex->find(block_id))
+            return header->timestamp;
+
     auto found = handler.db.fetch_block_by_id(block_id);
     if (!found) return fc::time_point::min();
     return found->timestamp;
@@ -265,6 +327,61 @@ uint8_t P2pHandler::NodeInterface::get_current_block_interval_in_seconds() const
     return handler.db.get_global_properties().parameters.block_interval;
 }
 
+void P2pHandler::primeBlockIds() {
+    auto headNum = db.head_block_num();
+    if (headNum == 0)
+        return;
+
+    auto firstNum = headNum > blockIds.capacity()? headNum - blockIds.capacity() + 1 : 1;
+    for (auto num = firstNum; num <= headNum; ++num) {
+        // A chain restored from a snapshot has no blocks prior to the snapshot's head block
+        try {
+            blockIds.setHead(num, db.get_block_id_for_num(num));
+        } catch (const fc::exception&) {
+            continue;
+        }
+    }
+}
+
+SyncTracker::Snapshot P2pHandler::getSyncStatus() {
+    return syncTracker.snapshot(db.get_global_properties().parameters.block_interval);
+}
+
+void P2pHandler::reportSyncStatus() {
+    auto status = getSyncStatus();
+    // If no blocks were handled since the last report, there's nothing new to report
+    if (status.blocksHandled == lastReportedBlocks) {
+        scheduleSyncReport();
+        return;
+    }
+    lastReportedBlocks = status.blocksHandled;
+
+    if (syncing || status.etaSeconds != 0)
+        ilog("Sync status: block #${num} (${time}), ${bps} blocks/s, ${tps} trx/s, handling p50 ${p50}us p99 ${p99}us, "
+             "${peers} peers, ${left} items remaining, ETA ${eta}s",
+             ("num", status.headBlockNum)("time", status.headBlockTime)("bps", status.blocksPerSecond)
+             ("tps", status.transactionsPerSecond)("p50", status.latencyP50)("p99", status.latencyP99)
+             ("peers", status.connectionCount)("left", status.itemsRemaining)("eta", status.etaSeconds));
+    else
+        dlog("Sync status: ${S}", ("S", status));
+
+    scheduleSyncReport();
+}
+
+void P2pHandler::scheduleSyncReport() {
+    syncReportTask = fc::schedule([this] { reportSyncStatus(); },
+                                  fc::time_point::now() + fc::seconds(SYNC_REPORT_INTERVAL_SECONDS),
+                                  "Sync status report");
+}
+
+void P2pHandler::blockApplied(const Chain::signed_block& block) {
+    blockIds.setHead(block.block_num(), block.id());
+    inventoryFilter.blockSeen(block.id(), block.block_num());
+    blockMessages.insert(block);
+    transactionPool.removeIncluded(block);
+    transactionPool.prune(block.timestamp);
+}
+
 void P2pHandler::syncFrom(Chain::block_id_type blockId) {
     node.sync_from(Net::item_id(Net::block_message_type, blockId), {});
     syncing = true;
@@ -1,10 +1,23 @@
 #pragma once
 
+#include "WorkerPool.hpp"
+#include "BlockPipeline.hpp"
+#include "TransactionIdCache.hpp"
+#include "BlockIdIndex.hpp"
+#include "BlockMessageCache.hpp"
+#include "BlockHeaderIndex.hpp"
+#include "SyncTracker.hpp"
+#include "TransactionPool.hpp"
+#include "InventoryFilter.hpp"
+
 #include <graphene/net/node.hpp>
 #include <graphene/chain/database.hpp>
 
 #include <boost/signals2/signal.hpp>
 
+#include <memory>
+#include <optional>
+
 namespace Net = graphene::net;
 namespace Chain = graphene::chain;
 
@@ -16,6 +29,7 @@ class P2pHandler {
         P2pHandler& handler;
 
         bool blockIsInOurChain(Chain::block_id_type id);
+        Chain::block_id_type blockIdForNum(uint32_t blockNum);
 
     public:
         NodeInterface(P2pHandler& handler);
@@ -41,23 +55,81 @@ class P2pHandler {
 
     Net::node node;
     const Chain::database& db;
+    // Index of block headers, if available, to answer header queries without loading blocks
+    const BlockHeaderIndex* headerIndex = nullptr;
     bool syncing = false;
     std::unique_ptr<NodeInterface> nodeInterface = std::make_unique<NodeInterface>(*this);
+    // Threads for the stateless stage of block ingestion
+    WorkerPool workers{0, "Block pre-validation"};
+    // Pipeline which pre-validates incoming blocks in parallel, then emits them in order via blockReceived
+    BlockPipeline pipeline{workers, [this](const Chain::signed_block& block) { blockReceived(block); }};
+    // Message IDs of the transactions in recently received blocks
+    TransactionIdCache transactionIds;
+    // IDs of the blocks at the end of our chain, by number
+    BlockIdIndex blockIds;
+    // Serialized messages of recently applied or requested blocks
+    BlockMessageCache blockMessages;
+    // Transactions received from the network which are not yet in a block
+    TransactionPool transactionPool;
+    // Filter of the inventory we've seen, to skip lookups for inventory we certainly haven't
+    InventoryFilter inventoryFilter{db.head_block_num()};
+
+    // Progress of the sync, and the task that periodically logs it
+    SyncTracker syncTracker;
+    fc::future<void> syncReportTask;
+    // Blocks handled as of the last report, to skip reporting when nothing has happened
+    std::optional<uint64_t> lastReportedBlocks;
+
+    void primeBlockIds();
+    void reportSyncStatus();
+    void scheduleSyncReport();
 
 public:
-    P2pHandler(const Chain::database& db) : node("Pollaris Backend Node"), db(db) {
+    // Number of block IDs kept in memory, beyond the reversible range, to serve peers syncing from us
+    constexpr static size_t DEFAULT_BLOCK_ID_TAIL = 10000;
+    // How often to log the progress of the sync
+    constexpr static int64_t SYNC_REPORT_INTERVAL_SECONDS = 30;
+
+    P2pHandler(const Chain::database& db, const BlockHeaderIndex* headerIndex = nullptr,
+               size_t blockIdTail = DEFAULT_BLOCK_ID_TAIL)
+        : node("Pollaris Backend Node"), db(db), headerIndex(headerIndex),
+          blockIds(GRAPHENE_MAX_UNDO_HISTORY + blockIdTail) {
+        primeBlockIds();
         node.load_configuration(fc::home_path() / ".config/Follow My Vote/PollarisBackend/p2p");
         node.set_node_delegate(nodeInterface.get());
+        scheduleSyncReport();
     }
     ~P2pHandler() {
+        if (syncReportTask.valid() && !syncReportTask.ready())
+            syncReportTask.cancel_and_wait("P2pHandler destroyed");
+        pipeline.stop();
         node.close();
     }
 
     bool isSyncing() const { return syncing; }
+    // Hold off emitting received blocks until the returned guard is destroyed. Blocks keep arriving and being
+    // pre-validated meanwhile, until the pipeline fills.
+    std::shared_ptr<void> holdBlocks() {
+        pipeline.hold();
+        return std::shared_ptr<void>(nullptr, [this](void*) { pipeline.release(); });
+    }
+    const BlockMessageCache::Counters& getBlockMessageCacheCounters() const { return blockMessages.getCounters(); }
+    const TransactionPool& getTransactionPool() const { return transactionPool; }
+    const InventoryFilter::Counters& getInventoryFilterCounters() const { return inventoryFilter.getCounters(); }
+    // Get a summary of the sync's progress
+    SyncTracker::Snapshot getSyncStatus();
     void syncFrom(Chain::block_id_type blockId);
 
     void connectToSeeds();
 
+    // Notification that the chain has applied a block, which is now the head block
+    void blockApplied(const Chain::signed_block& block);
+    // Notification that a block received from the network was pushed to the chain, and how long the push took. This
+    // includes blocks which arrived early and were held until the blocks before them were applied.
+    void blockPushed(const Chain::signed_block& block, fc::microseconds pushTime) {
+        syncTracker.blockHandled(block.block_num(), block.timestamp, block.transactions.size(), pushTime);
+    }
+
     Sgnl::signal<void(Chain::signed_block)> blockReceived;
     Sgnl::signal<void(Chain::signed_transaction)> transactionReceived;
     Sgnl::signal<void()> syncFinished;
@@ -0,0 +1,80 @@
+#include "RotatingBloomFilter.hpp"
+
+#include <fc/crypto/city.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+RotatingBloomFilter::RotatingBloomFilter(size_t itemsPerGeneration, double falsePositiveRate,
+                                         Clock::duration generationSpan)
+    : itemsPerGeneration(std::max<size_t>(itemsPerGeneration, 1)), generationSpan(generationSpan) {
+    // Standard Bloom filter sizing: m = -n ln(p) / ln(2)^2 bits, and k = (m / n) ln(2) hashes
+    falsePositiveRate = std::clamp(falsePositiveRate, 1e-9, .5);
+    auto bits = -double(this->itemsPerGeneration) * std::log(falsePositiveRate) / (std::log(2) * std::log(2));
+    bitCount = std::max<size_t>(64, static_cast<size_t>(std::ceil(bits / 64)) * 64);
+    hashCount = std::max<size_t>(1, static_cast<size_t>(std::round(bitCount / double(this->itemsPerGeneration) *
+                                                                   std::log(2))));
+
+    auto now = Clock::now();
+    for (auto& generation : generations) {
+        generation.bits.resize(bitCount / 64);
+        generation.started = now;
+    }
+    generations[current].used = true;
+}
+
+template<typename F>
+void RotatingBloomFilter::forEachBit(const char* data, size_t size, F&& f) const {
+    // Double hashing: bit i is (h1 + i*h2) mod m. Items may share long prefixes (a block ID begins with the block's
+    // number, so consecutive blocks differ in few of their leading bytes), so hash the whole item rather than taking
+    // bits from it directly, and derive h2 from h1 with a 64-bit mix.
+    uint64_t h1 = fc::city_hash64(data, size);
+    // The splitmix64 finalizer
+    uint64_t h2 = h1;
+    h2 = (h2 ^ (h2 >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h2 = (h2 ^ (h2 >> 27)) * 0x94D049BB133111EBull;
+    h2 = (h2 ^ (h2 >> 31)) | 1;
+
+    for (size_t i = 0; i < hashCount; ++i)
+        f((h1 + i * h2) % bitCount);
+}
+
+void RotatingBloomFilter::insert(const char* data, size_t size) {
+    auto& generation = generations[current];
+    forEachBit(data, size, [&generation](size_t bit) { generation.bits[bit / 64] |= uint64_t(1) << (bit % 64); });
+    ++generation.itemCount;
+}
+
+bool RotatingBloomFilter::mayContain(const char* data, size_t size) const {
+    for (const auto& generation : generations) {
+        if (!generation.used)
+            continue;
+        bool all = true;
+        forEachBit(data, size, [&generation, &all](size_t bit) {
+            all = all && (generation.bits[bit / 64] & (uint64_t(1) << (bit % 64)));
+        });
+        if (all)
+            return true;
+    }
+    return false;
+}
+
+bool RotatingBloomFilter::rotateIfDue() {
+    auto now = Clock::now();
+    const auto& active = generations[current];
+    if (active.itemCount < itemsPerGeneration && now - active.started < generationSpan)
+        return false;
+
+    current = 1 - current;
+    auto& fresh = generations[current];
+    std::fill(fresh.bits.begin(), fresh.bits.end(), 0);
+    fresh.itemCount = 0;
+    fresh.started = now;
+    fresh.used = true;
+    return true;
+}
+
+RotatingBloomFilter::Clock::time_point RotatingBloomFilter::coverageStart() const {
+    const auto& previous = generations[1 - current];
+    return previous.used? previous.started : generations[current].started;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// A Bloom filter which forgets old items by rotating through two generations.
+//
+// Items are inserted into the current generation, and looked up in both. When the current generation is full or has
+// been in use for its span of time, it becomes the previous generation and the old previous generation is cleared to
+// become the new current one. Thus an item is remembered for at least one generation span (or generation's worth of
+// insertions) after it's inserted, and a negative answer means the item definitely wasn't inserted since the previous
+// generation began.
+//
+// The filter derives its bit positions from a 64-bit hash of the whole item, so items which are largely alike, such as
+// the IDs of consecutive blocks, still set independent bits.
+class RotatingBloomFilter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Size the filter to hold itemsPerGeneration items per generation at the given false positive rate
+    RotatingBloomFilter(size_t itemsPerGeneration, double falsePositiveRate, Clock::duration generationSpan);
+
+    void insert(const char* data, size_t size);
+    // Returns false if the item was definitely not inserted since coverageStart(); true if it may have been
+    bool mayContain(const char* data, size_t size) const;
+
+    // Rotate generations if the current one is full or old enough. Returns true if the filter rotated.
+    bool rotateIfDue();
+    // The time since which every inserted item is still in the filter
+    Clock::time_point coverageStart() const;
+
+    size_t bitsPerGeneration() const { return bitCount; }
+    size_t hashesPerItem() const { return hashCount; }
+
+private:
+    struct Generation {
+        std::vector<uint64_t> bits;
+        size_t itemCount = 0;
+        Clock::time_point started;
+        bool used = false;
+    };
+
+    size_t bitCount;
+    size_t hashCount;
+    size_t itemsPerGeneration;
+    Clock::duration generationSpan;
+    std::array<Generation, 2> generations;
+    size_t current = 0;
+
+    template<typename F>
+    void forEachBit(const char* data, size_t size, F&& f) const;
+};
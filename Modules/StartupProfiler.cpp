@@ -0,0 +1,75 @@
+#include "StartupProfiler.hpp"
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+#include <sys/resource.h>
+
+StartupProfiler::StartupProfiler() : started(sample()) {}
+
+StartupProfiler::Sample StartupProfiler::sample() const {
+    Sample s;
+    s.wall = std::chrono::steady_clock::now();
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        s.cpuMicroseconds = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll +
+                            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+        // Linux reports this in kilobytes
+        s.peakRssKilobytes = usage.ru_maxrss;
+    }
+    if (objectCounter)
+        s.objects = objectCounter();
+    return s;
+}
+
+StartupProfiler::Scope StartupProfiler::phase(const std::string& name) {
+    if (finished)
+        return Scope();
+
+    Phase phase;
+    phase.name = open.empty()? name : report.phases[open.back()].name + "/" + name;
+    phase.depth = open.size();
+    report.phases.emplace_back(std::move(phase));
+    phaseStarts.emplace_back(sample());
+    open.push_back(report.phases.size() - 1);
+    return Scope(this, report.phases.size() - 1);
+}
+
+void StartupProfiler::endPhase(size_t index) {
+    if (finished)
+        return;
+
+    auto end = sample();
+    const auto& start = phaseStarts[index];
+    auto& phase = report.phases[index];
+    phase.wallMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(end.wall - start.wall).count();
+    phase.cpuMicroseconds = end.cpuMicroseconds - start.cpuMicroseconds;
+    phase.peakRssDeltaKilobytes = end.peakRssKilobytes - start.peakRssKilobytes;
+    phase.objectsDelta = end.objects - start.objects;
+
+    // Phases end innermost first, but if an outer one ends first, stop nesting new phases in the ones it contains
+    auto itr = std::find(open.begin(), open.end(), index);
+    if (itr != open.end())
+        open.erase(itr, open.end());
+}
+
+const StartupProfiler::Report& StartupProfiler::finish() {
+    if (finished)
+        return report;
+
+    while (!open.empty())
+        endPhase(open.back());
+    auto end = sample();
+    report.wallMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(end.wall - started.wall).count();
+    report.cpuMicroseconds = end.cpuMicroseconds - started.cpuMicroseconds;
+    report.peakRssKilobytes = end.peakRssKilobytes;
+    report.objects = end.objects;
+    finished = true;
+    return report;
+}
+
+void StartupProfiler::writeReport(const Report& report, const fc::path& file) {
+    fc::json::save_to_file(fc::variant(report, 10), file);
+}
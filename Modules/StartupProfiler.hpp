@@ -0,0 +1,107 @@
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Measures the phases of the node's startup, for a machine-readable report of where startup time goes.
+//
+// Each phase records its wall time, the CPU time the process spent during it, how much it raised the process's peak
+// resident set size, and how many objects it added, as counted by the object counter if one is set. Phases may nest;
+// a nested phase is named by its path, like "initializeBlockchain/plugin ExampleContract", and its parent's figures
+// include it. Phases are listed in the report in the order they began.
+//
+// Once the report is finished, phases are no longer recorded, so code shared with later activity, like loading plugins
+// on request, costs nothing to profile.
+class StartupProfiler {
+public:
+    struct Phase {
+        std::string name;
+        uint32_t depth = 0;
+        int64_t wallMicroseconds = 0;
+        int64_t cpuMicroseconds = 0;
+        int64_t peakRssDeltaKilobytes = 0;
+        int64_t objectsDelta = 0;
+    };
+    struct Report {
+        int64_t wallMicroseconds = 0;
+        int64_t cpuMicroseconds = 0;
+        int64_t peakRssKilobytes = 0;
+        int64_t objects = 0;
+        std::vector<Phase> phases;
+    };
+
+    // Ends its phase when destroyed
+    class Scope {
+        StartupProfiler* profiler = nullptr;
+        size_t phase = 0;
+
+    public:
+        Scope() = default;
+        Scope(StartupProfiler* profiler, size_t phase) : profiler(profiler), phase(phase) {}
+        Scope(Scope&& other) : profiler(other.profiler), phase(other.phase) { other.profiler = nullptr; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope& operator=(Scope&& other) {
+            if (this != &other) {
+                end();
+                profiler = other.profiler;
+                phase = other.phase;
+                other.profiler = nullptr;
+            }
+            return *this;
+        }
+        ~Scope() { end(); }
+
+        // End the phase early
+        void end() {
+            if (profiler != nullptr)
+                profiler->endPhase(phase);
+            profiler = nullptr;
+        }
+    };
+
+    StartupProfiler();
+
+    // Set the function that counts objects; it should be cheap, as it's called at the start and end of every phase
+    void setObjectCounter(std::function<uint64_t()> counter) { objectCounter = std::move(counter); }
+
+    // Begin a phase, nested in any phases in progress. The phase ends when the returned scope is destroyed.
+    Scope phase(const std::string& name);
+
+    // Finish profiling and get the report
+    const Report& finish();
+    bool isFinished() const { return finished; }
+
+    // Write the report as JSON
+    static void writeReport(const Report& report, const fc::path& file);
+
+private:
+    struct Sample {
+        std::chrono::steady_clock::time_point wall;
+        int64_t cpuMicroseconds = 0;
+        int64_t peakRssKilobytes = 0;
+        int64_t objects = 0;
+    };
+
+    std::function<uint64_t()> objectCounter;
+    Sample started;
+    // Samples at the start of each phase, in the order the phases began
+    std::vector<Sample> phaseStarts;
+    // Phases in progress, innermost last
+    std::vector<size_t> open;
+    Report report;
+    bool finished = false;
+
+    Sample sample() const;
+    void endPhase(size_t phase);
+};
+
+FC_REFLECT(StartupProfiler::Phase,
+           (name)(depth)(wallMicroseconds)(cpuMicroseconds)(peakRssDeltaKilobytes)(objectsDelta))
+FC_REFLECT(StartupProfiler::Report, (wallMicroseconds)(cpuMicroseconds)(peakRssKilobytes)(objects)(phases))
@@ -0,0 +1,292 @@
+#include "StateCheckpointer.hpp"
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace db = graphene::db;
+
+namespace {
+constexpr size_t BUFFER_SIZE = 1 << 20;
+const char* const METADATA_FILE = "checkpoint.meta";
+
+std::string checkpointName(uint32_t blockNum) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "checkpoint-%010u", blockNum);
+    return name;
+}
+
+std::string relativePath(const fc::path& file, const fc::path& root) {
+    auto path = file.generic_string();
+    auto base = root.generic_string() + "/";
+    FC_ASSERT(path.compare(0, base.size(), base) == 0, "[StateCheckpointer] ${F} is not under ${R}",
+              ("F", path)("R", root));
+    return path.substr(base.size());
+}
+
+StateCheckpointer::FileRecord hashFile(const fc::path& file, const fc::path& root) {
+    StateCheckpointer::FileRecord record;
+    record.path = relativePath(file, root);
+    std::ifstream in(file.string(), std::ios::binary);
+    FC_ASSERT(in.good(), "[StateCheckpointer] Could not read ${F}", ("F", file));
+    fc::sha256::encoder encoder;
+    std::vector<char> buffer(BUFFER_SIZE);
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        encoder.write(buffer.data(), in.gcount());
+        record.size += in.gcount();
+    }
+    record.checksum = encoder.result();
+    return record;
+}
+
+// Save each of a database's indexes to the directory, laid out as the database lays out its own files
+void saveDatabase(const db::object_database& database, const fc::path& directory, const fc::path& root,
+                  std::vector<StateCheckpointer::FileRecord>& files) {
+    for (unsigned space = 0; space < 256; ++space) {
+        try {
+            database.inspect_all_indexes(space, [&](const db::index& index) {
+                auto file = directory / std::to_string(space) / std::to_string(index.object_type_id());
+                fc::create_directories(file.parent_path());
+                // Saving needs a mutable index, but this only runs in the checkpoint process, whose database is a
+                // private copy of the node's, and saving doesn't change the objects anyway
+                const_cast<db::index&>(index).save(file);
+                files.emplace_back(hashFile(file, root));
+            });
+        } catch (const fc::exception&) {
+            // The database has no indexes in this space, nor in any space after it
+            break;
+        }
+    }
+}
+
+// Close the file descriptors the checkpoint process inherited from the node, other than the standard streams, so it
+// doesn't hold the node's sockets and files open while it runs
+void closeInheritedDescriptors() {
+    std::vector<int> descriptors;
+    if (DIR* directory = opendir("/proc/self/fd")) {
+        while (const dirent* entry = readdir(directory)) {
+            int fd = std::atoi(entry->d_name);
+            if (fd > STDERR_FILENO && fd != dirfd(directory))
+                descriptors.push_back(fd);
+        }
+        closedir(directory);
+    } else {
+        for (int fd = STDERR_FILENO + 1; fd < sysconf(_SC_OPEN_MAX); ++fd)
+            descriptors.push_back(fd);
+    }
+    for (int fd : descriptors)
+        close(fd);
+}
+
+// Read a checkpoint's metadata, verifying its checksum
+StateCheckpointer::Metadata readMetadata(const fc::path& file) {
+    std::string content;
+    fc::read_file_contents(file, content);
+    constexpr auto hashSize = sizeof(fc::sha256);
+    FC_ASSERT(content.size() > hashSize, "[StateCheckpointer] Checkpoint metadata ${F} is truncated", ("F", file));
+    auto size = content.size() - hashSize;
+    fc::sha256 checksum;
+    std::copy_n(content.data() + size, hashSize, checksum.data());
+    FC_ASSERT(fc::sha256::hash(content.data(), size) == checksum,
+              "[StateCheckpointer] Checkpoint metadata ${F} is corrupt", ("F", file));
+    return fc::raw::unpack<StateCheckpointer::Metadata>(std::vector<char>(content.begin(), content.begin() + size));
+}
+
+// Replace an object database with the one saved under checkpointDatabase, leaving the checkpoint as it was
+void restoreDatabase(const fc::path& checkpointDatabase, const fc::path& dataDirectory) {
+    auto temporary = dataDirectory / "object_database.tmp";
+    auto target = dataDirectory / "object_database";
+    auto old = dataDirectory / "object_database.old";
+    fc::remove_all(temporary);
+    fc::create_directories(temporary);
+    if (fc::is_directory(checkpointDatabase)) {
+        for (fc::recursive_directory_iterator itr(checkpointDatabase); itr != fc::recursive_directory_iterator();
+             ++itr) {
+            if (!fc::is_regular_file(*itr))
+                continue;
+            auto destination = temporary / relativePath(*itr, checkpointDatabase);
+            fc::create_directories(destination.parent_path());
+            fc::copy(*itr, destination);
+        }
+    }
+    if (fc::exists(target))
+        fc::rename(target, old);
+    fc::rename(temporary, target);
+    fc::remove_all(old);
+}
+} // namespace
+
+StateCheckpointer::StateCheckpointer() : StateCheckpointer(Options()) {}
+StateCheckpointer::StateCheckpointer(Options options) : options(options) {}
+
+StateCheckpointer::~StateCheckpointer() {
+    // Don't hold up shutdown for a checkpoint; the databases are flushed on a clean shutdown anyways. The interrupted
+    // checkpoint is left incomplete, and is cleaned up next time.
+    if (child > 0) {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+}
+
+void StateCheckpointer::open(const fc::path& directory) {
+    fc::create_directories(directory);
+    this->directory = directory;
+    auto checkpoints = list();
+    lastBlockNum = checkpoints.empty()? 0 : checkpoints.front().first;
+    prune();
+}
+
+void StateCheckpointer::blockApplied(uint32_t blockNum, const block_id_type& blockId, const db::object_database& chain,
+                                     const db::object_database& persistence) {
+    reap();
+    if (options.interval == 0 || directory.string().empty() || child > 0 || blockNum < lastBlockNum + options.interval)
+        return;
+
+    // Whatever happens, don't try again until the next interval
+    lastBlockNum = blockNum;
+    auto path = directory / checkpointName(blockNum);
+    auto pid = fork();
+    if (pid < 0) {
+        elog("[StateCheckpointer] Could not fork to take a checkpoint at block ${N}", ("N", blockNum));
+        return;
+    }
+    if (pid == 0) {
+        // We're the checkpoint process. Only this thread exists here, and any lock another thread of the node held at
+        // the fork stays locked, so do nothing but write the checkpoint: no logging, and no fc tasks or threads. If
+        // the process hangs regardless, the node kills it once it's overdue.
+        closeInheritedDescriptors();
+        int status = 1;
+        try {
+            write(path, blockNum, blockId, chain, persistence);
+            status = 0;
+        } catch (...) {
+        }
+        _exit(status);
+    }
+
+    child = pid;
+    childBlockNum = blockNum;
+    childStarted = fc::time_point::now();
+    dlog("[StateCheckpointer] Taking a checkpoint at block ${N} in process ${P}", ("N", blockNum)("P", pid));
+}
+
+void StateCheckpointer::reap() {
+    if (child <= 0)
+        return;
+    int status = 0;
+    auto result = waitpid(child, &status, WNOHANG);
+    if (result == 0) {
+        if (fc::time_point::now() - childStarted < options.timeout)
+            return;
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        child = 0;
+        elog("[StateCheckpointer] Checkpoint at block ${N} did not finish in ${T}s; killed its process",
+             ("N", childBlockNum)("T", options.timeout.to_seconds()));
+        prune();
+        return;
+    }
+
+    bool succeeded = result == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    child = 0;
+    if (succeeded) {
+        ilog("[StateCheckpointer] Took a checkpoint at block ${N} in ${T}ms",
+             ("N", childBlockNum)("T", (fc::time_point::now() - childStarted).count() / 1000));
+        prune();
+    } else {
+        elog("[StateCheckpointer] Failed to take a checkpoint at block ${N}", ("N", childBlockNum));
+    }
+}
+
+std::vector<std::pair<uint32_t, fc::path>> StateCheckpointer::list() const {
+    std::vector<std::pair<uint32_t, fc::path>> checkpoints;
+    if (!fc::is_directory(directory))
+        return checkpoints;
+    for (fc::directory_iterator itr(directory); itr != fc::directory_iterator(); ++itr) {
+        unsigned blockNum = 0;
+        char suffix[16] = {};
+        auto name = itr->filename().string();
+        if (std::sscanf(name.c_str(), "checkpoint-%10u%15s", &blockNum, suffix) == 1)
+            checkpoints.emplace_back(blockNum, *itr);
+    }
+    std::sort(checkpoints.begin(), checkpoints.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    return checkpoints;
+}
+
+void StateCheckpointer::prune() {
+    auto checkpoints = list();
+    for (size_t i = options.keep; i < checkpoints.size(); ++i)
+        fc::remove_all(checkpoints[i].second);
+
+    // Remove incomplete checkpoints, unless one's being written right now
+    if (child > 0)
+        return;
+    for (fc::directory_iterator itr(directory); itr != fc::directory_iterator(); ++itr)
+        if (itr->extension() == ".partial")
+            fc::remove_all(*itr);
+}
+
+std::optional<StateCheckpointer::Checkpoint> StateCheckpointer::findLatest(
+        const std::function<bool(uint32_t, const block_id_type&)>& onChain) const {
+    for (const auto& [blockNum, path] : list()) {
+        try {
+            auto metadata = readMetadata(path / METADATA_FILE);
+            FC_ASSERT(metadata.version == VERSION, "[StateCheckpointer] Checkpoint version ${V} is not supported",
+                      ("V", metadata.version));
+            if (!onChain(metadata.blockNum, metadata.blockId)) {
+                wlog("[StateCheckpointer] Checkpoint at block ${N} is not on the chain; skipping it",
+                     ("N", metadata.blockNum));
+                continue;
+            }
+            for (const auto& file : metadata.files) {
+                auto actual = hashFile(path / file.path, path);
+                FC_ASSERT(actual.size == file.size && actual.checksum == file.checksum,
+                          "[StateCheckpointer] Checkpoint file ${F} is corrupt", ("F", file.path));
+            }
+            return Checkpoint{metadata.blockNum, metadata.blockId, path};
+        } catch (const fc::exception& e) {
+            wlog("[StateCheckpointer] Checkpoint ${P} is not usable: ${E}", ("P", path)("E", e.to_string()));
+        }
+    }
+    return {};
+}
+
+void StateCheckpointer::restore(const Checkpoint& checkpoint, const fc::path& chainDirectory,
+                                const fc::path& persistenceDirectory) {
+    restoreDatabase(checkpoint.path / "Chain" / "object_database", chainDirectory);
+    restoreDatabase(checkpoint.path / "NodePersistence" / "object_database", persistenceDirectory);
+}
+
+void StateCheckpointer::write(const fc::path& path, uint32_t blockNum, const block_id_type& blockId,
+                              const db::object_database& chain, const db::object_database& persistence) {
+    fc::path partial(path.string() + ".partial");
+    fc::remove_all(partial);
+
+    Metadata metadata;
+    metadata.version = VERSION;
+    metadata.blockNum = blockNum;
+    metadata.blockId = blockId;
+    saveDatabase(chain, partial / "Chain" / "object_database", partial, metadata.files);
+    saveDatabase(persistence, partial / "NodePersistence" / "object_database", partial, metadata.files);
+
+    auto bytes = fc::raw::pack(metadata);
+    auto checksum = fc::sha256::hash(bytes.data(), bytes.size());
+    {
+        std::ofstream out((partial / METADATA_FILE).string(), std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size());
+        out.write(checksum.data(), checksum.data_size());
+        FC_ASSERT(out.good(), "[StateCheckpointer] Failed to write checkpoint metadata");
+    }
+    fc::rename(partial, path);
+}
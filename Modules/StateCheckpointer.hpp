@@ -0,0 +1,107 @@
+#pragma once
+
+#include <graphene/db/object_database.hpp>
+#include <graphene/protocol/types.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <sys/types.h>
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Periodic checkpoints of the node's databases, so that after an unclean shutdown the node can resume from a recent
+// checkpoint instead of replaying the whole chain.
+//
+// A checkpoint is taken in a forked child process, which writes out its copy-on-write image of the chain and
+// persistence object databases while the node carries on applying blocks. The image is of the state as of the block
+// just applied when the checkpoint began. The child closes the descriptors it inherits, and is killed if it overruns
+// its deadline. Each checkpoint is a directory holding the databases in the same layout as their data directories, and
+// a metadata file listing every file with its size and checksum, itself checksummed. The directory only takes its
+// final name once everything is written, so a checkpoint interrupted midway is never used.
+//
+// A checkpoint is only valid if its block is still in the chain; the caller decides that when looking for one to
+// restore.
+class StateCheckpointer {
+public:
+    using block_id_type = graphene::protocol::block_id_type;
+
+    struct Options {
+        // Blocks between checkpoints; zero disables checkpoints
+        uint32_t interval = 10000;
+        // Number of completed checkpoints to keep
+        uint32_t keep = 2;
+        // Time a checkpoint may take before its process is killed and the checkpoint abandoned
+        fc::microseconds timeout = fc::minutes(30);
+    };
+    struct Checkpoint {
+        uint32_t blockNum = 0;
+        block_id_type blockId;
+        fc::path path;
+    };
+
+    struct FileRecord {
+        // Path relative to the checkpoint directory
+        std::string path;
+        uint64_t size = 0;
+        fc::sha256 checksum;
+    };
+    struct Metadata {
+        uint32_t version = 0;
+        uint32_t blockNum = 0;
+        block_id_type blockId;
+        std::vector<FileRecord> files;
+    };
+
+    StateCheckpointer();
+    explicit StateCheckpointer(Options options);
+    ~StateCheckpointer();
+
+    // Set the directory to keep checkpoints in, creating it if necessary
+    void open(const fc::path& directory);
+    const fc::path& getDirectory() const { return directory; }
+
+    // Notify the checkpointer that a block was applied. If a checkpoint is due, it is begun; if one finished since the
+    // last call, its result is logged and old checkpoints are pruned. Call this from the thread applying blocks, while
+    // the databases hold the state as of the block.
+    void blockApplied(uint32_t blockNum, const block_id_type& blockId, const graphene::db::object_database& chain,
+                      const graphene::db::object_database& persistence);
+    bool inProgress() const { return child > 0; }
+
+    // Find the newest checkpoint whose files are intact, and whose block onChain confirms is still in the chain
+    std::optional<Checkpoint> findLatest(const std::function<bool(uint32_t, const block_id_type&)>& onChain) const;
+    // Replace the object databases in the given data directories with a checkpoint's
+    static void restore(const Checkpoint& checkpoint, const fc::path& chainDirectory,
+                        const fc::path& persistenceDirectory);
+
+private:
+    constexpr static uint32_t VERSION = 1;
+
+    Options options;
+    fc::path directory;
+    // Block of the last checkpoint taken or begun
+    uint32_t lastBlockNum = 0;
+    // The process writing the current checkpoint, if there is one, and what it's writing
+    pid_t child = 0;
+    uint32_t childBlockNum = 0;
+    fc::time_point childStarted;
+
+    // Collect the result of the current checkpoint, if it's finished, or abandon it if it's overdue
+    void reap();
+    // Remove all but the newest checkpoints, and any incomplete ones
+    void prune();
+    // List the completed checkpoints, newest first
+    std::vector<std::pair<uint32_t, fc::path>> list() const;
+
+    // Write a checkpoint. Runs in the child process.
+    static void write(const fc::path& path, uint32_t blockNum, const block_id_type& blockId,
+                      const graphene::db::object_database& chain, const graphene::db::object_database& persistence);
+};
+
+FC_REFLECT(StateCheckpointer::FileRecord, (path)(size)(checksum))
+FC_REFLECT(StateCheckpointer::Metadata, (version)(blockNum)(blockId)(files))
@@ -0,0 +1,79 @@
+#include "SyncTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+void SyncTracker::blockHandled(uint32_t blockNum, fc::time_point_sec blockTime, size_t transactionCount,
+                               fc::microseconds handlingTime) {
+    auto now = fc::time_point::now();
+    recentBlocks.push_back({now, transactionCount});
+    pruneWindow(now);
+
+    ++blocksHandled;
+    transactionsHandled += transactionCount;
+    headBlockNum = blockNum;
+    headBlockTime = blockTime;
+
+    auto micros = std::max<int64_t>(handlingTime.count(), 1);
+    size_t bucket = 0;
+    while (bucket + 1 < LATENCY_BUCKETS && (int64_t(1) << (bucket + 1)) <= micros)
+        ++bucket;
+    ++latencyHistogram[bucket];
+}
+
+SyncTracker::Snapshot SyncTracker::snapshot(uint8_t blockInterval) {
+    auto now = fc::time_point::now();
+    pruneWindow(now);
+
+    Snapshot snapshot;
+    // Until we've been running for a whole window, only count the time we've been running
+    double seconds = std::max(std::min(window, now - startTime).count() / 1e6, 1.0);
+    auto transactions = std::accumulate(recentBlocks.begin(), recentBlocks.end(), size_t(0),
+                                        [](size_t sum, const Event& e) { return sum + e.transactionCount; });
+    snapshot.blocksPerSecond = recentBlocks.size() / seconds;
+    snapshot.transactionsPerSecond = transactions / seconds;
+    snapshot.blocksHandled = blocksHandled;
+    snapshot.transactionsHandled = transactionsHandled;
+    snapshot.latencyHistogram = latencyHistogram;
+    snapshot.latencyP50 = latencyPercentile(.5);
+    snapshot.latencyP99 = latencyPercentile(.99);
+    snapshot.connectionCount = connectionCount;
+    snapshot.itemsRemaining = itemsRemaining;
+    snapshot.peerItemsRemaining = peerItemsRemaining;
+    snapshot.headBlockNum = headBlockNum;
+    snapshot.headBlockTime = headBlockTime;
+
+    // Estimate how far behind we are: by the P2P node's count if it has one, otherwise by the age of our head block
+    double blocksBehind = itemsRemaining;
+    if (blocksBehind == 0 && blockInterval > 0 && headBlockTime != fc::time_point_sec() &&
+            now > fc::time_point(headBlockTime))
+        blocksBehind = (now - fc::time_point(headBlockTime)).to_seconds() / double(blockInterval);
+    if (blocksBehind < 1)
+        snapshot.etaSeconds = 0;
+    else if (snapshot.blocksPerSecond > 0)
+        snapshot.etaSeconds = static_cast<int64_t>(std::ceil(blocksBehind / snapshot.blocksPerSecond));
+
+    return snapshot;
+}
+
+void SyncTracker::pruneWindow(fc::time_point now) {
+    while (!recentBlocks.empty() && recentBlocks.front().time < now - window)
+        recentBlocks.pop_front();
+}
+
+uint64_t SyncTracker::latencyPercentile(double fraction) const {
+    auto total = std::accumulate(latencyHistogram.begin(), latencyHistogram.end(), uint64_t(0));
+    if (total == 0)
+        return 0;
+
+    // Report the upper bound of the bucket the percentile falls in
+    auto target = static_cast<uint64_t>(std::ceil(total * fraction));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < latencyHistogram.size(); ++bucket) {
+        seen += latencyHistogram[bucket];
+        if (seen >= target)
+            return uint64_t(1) << (bucket + 1);
+    }
+    return uint64_t(1) << latencyHistogram.size();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <deque>
+#include <vector>
+
+// Tracks how block sync is progressing, so we can tell whether a slow sync is waiting on peers or on us.
+//
+// The tracker is fed from the P2P node's callbacks and from timing the handling of each block, and it summarizes them
+// as rolling throughput, a histogram of block handling latency, and an estimate of the time left to reach the head.
+class SyncTracker {
+public:
+    // Number of latency histogram buckets; bucket i counts latencies of [2^i, 2^(i+1)) microseconds
+    constexpr static size_t LATENCY_BUCKETS = 24;
+
+    struct Snapshot {
+        // Rolling throughput over the tracker's window
+        double blocksPerSecond = 0;
+        double transactionsPerSecond = 0;
+        // Totals since the tracker was created
+        uint64_t blocksHandled = 0;
+        uint64_t transactionsHandled = 0;
+        // Histogram of the time taken to push each block to the chain
+        std::vector<uint64_t> latencyHistogram;
+        // Approximate median and 99th percentile block push time, in microseconds
+        uint64_t latencyP50 = 0;
+        uint64_t latencyP99 = 0;
+        // Number of peers we're connected to
+        uint32_t connectionCount = 0;
+        // Number of items the node still expects to sync from peers
+        uint32_t itemsRemaining = 0;
+        // Largest number of blocks a peer syncing from us still had to fetch, as of their latest request
+        uint32_t peerItemsRemaining = 0;
+        // Most recent block handled
+        uint32_t headBlockNum = 0;
+        fc::time_point_sec headBlockTime;
+        // Estimated seconds until we reach the head of the network's chain, or -1 if unknown
+        int64_t etaSeconds = -1;
+    };
+
+    // window is the span of time the rolling rates are computed over
+    SyncTracker(fc::microseconds window = fc::seconds(30)) : window(window) {}
+
+    // Record that a block was handled
+    void blockHandled(uint32_t blockNum, fc::time_point_sec blockTime, size_t transactionCount,
+                      fc::microseconds handlingTime);
+    // Record the P2P node's report of how many items remain to sync
+    void syncStatus(uint32_t itemCount) { itemsRemaining = itemCount; }
+    // Record the number of peers we're connected to
+    void connectionCountChanged(uint32_t count) { connectionCount = count; }
+    // Record the number of items remaining for a peer syncing from us
+    void peerRemainingItems(uint32_t itemCount) { peerItemsRemaining = itemCount; }
+
+    // Summarize the sync's progress. blockInterval is the chain's block interval in seconds.
+    Snapshot snapshot(uint8_t blockInterval);
+
+private:
+    struct Event {
+        fc::time_point time;
+        size_t transactionCount;
+    };
+
+    const fc::microseconds window;
+    const fc::time_point startTime = fc::time_point::now();
+    // Blocks handled within the window
+    std::deque<Event> recentBlocks;
+
+    uint64_t blocksHandled = 0;
+    uint64_t transactionsHandled = 0;
+    std::vector<uint64_t> latencyHistogram = std::vector<uint64_t>(LATENCY_BUCKETS);
+    uint32_t connectionCount = 0;
+    uint32_t itemsRemaining = 0;
+    uint32_t peerItemsRemaining = 0;
+    uint32_t headBlockNum = 0;
+    fc::time_point_sec headBlockTime;
+
+    void pruneWindow(fc::time_point now);
+    uint64_t latencyPercentile(double fraction) const;
+};
+
+FC_REFLECT(SyncTracker::Snapshot, (blocksPerSecond)(transactionsPerSecond)(blocksHandled)(transactionsHandled)
+                                  (latencyHistogram)(latencyP50)(latencyP99)(connectionCount)(itemsRemaining)
+                                  (peerItemsRemaining)(headBlockNum)(headBlockTime)(etaSeconds))
@@ -0,0 +1,65 @@
+#include "TransactionIdCache.hpp"
+
+#include <fc/io/datastream.hpp>
+#include <fc/io/raw.hpp>
+
+TransactionIdCache::message_id_type TransactionIdCache::computeMessageId(const signed_transaction& trx) {
+    // Reused between calls so we don't allocate for every transaction
+    thread_local std::vector<char> buffer;
+
+    // A trx_message serializes to exactly the transaction it carries, so hash the transaction's serialization directly
+    auto size = fc::raw::pack_size(trx);
+    if (buffer.size() < size)
+        buffer.resize(size);
+    fc::datastream<char*> stream(buffer.data(), size);
+    fc::raw::pack(stream, trx);
+    return fc::ripemd160::hash(buffer.data(), static_cast<uint32_t>(size));
+}
+
+const std::vector<TransactionIdCache::message_id_type>&
+TransactionIdCache::blockTransactionIds(const signed_block& block) {
+    auto blockId = block.id();
+    auto itr = blockIds.find(blockId);
+    if (itr != blockIds.end()) {
+        ++counters.reused;
+        return itr->second;
+    }
+
+    // Make room first, so eviction can't remove locations belonging to the new block
+    while (!blockOrder.empty() && blockOrder.size() >= maxBlocks)
+        evictOldest();
+
+    std::vector<message_id_type> ids;
+    ids.reserve(block.transactions.size());
+    for (uint32_t i = 0; i < block.transactions.size(); ++i) {
+        ids.push_back(computeMessageId(block.transactions[i]));
+        locations[ids.back()] = Location{blockId, i};
+    }
+
+    blockOrder.push_back(blockId);
+    ++counters.computed;
+    return blockIds.emplace(blockId, std::move(ids)).first->second;
+}
+
+std::optional<TransactionIdCache::Location> TransactionIdCache::find(const message_id_type& id) const {
+    auto itr = locations.find(id);
+    if (itr == locations.end())
+        return {};
+    return itr->second;
+}
+
+void TransactionIdCache::evictOldest() {
+    auto oldest = blockOrder.front();
+    blockOrder.pop_front();
+
+    auto itr = blockIds.find(oldest);
+    if (itr == blockIds.end())
+        return;
+    for (const auto& id : itr->second) {
+        // The same transaction may also be in a newer block (i.e. on another fork); leave that location alone
+        auto location = locations.find(id);
+        if (location != locations.end() && location->second.blockId == oldest)
+            locations.erase(location);
+    }
+    blockIds.erase(itr);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <graphene/net/message.hpp>
+#include <graphene/protocol/block.hpp>
+
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Caches the net::node message IDs of the transactions in recently received blocks.
+//
+// A transaction's message ID is the hash of the trx_message carrying it, which is just the serialized transaction.
+// Rather than building a full message for every transaction (copying the transaction, then serializing it into a new
+// buffer), we serialize each one once into a reusable buffer and hash that. The IDs for a block are computed once, then
+// reused to answer net::node queries about those transactions.
+class TransactionIdCache {
+public:
+    using signed_block = graphene::protocol::signed_block;
+    using signed_transaction = graphene::protocol::signed_transaction;
+    using block_id_type = graphene::protocol::block_id_type;
+    using message_id_type = graphene::net::message_hash_type;
+
+    // Where a cached transaction can be found
+    struct Location {
+        block_id_type blockId;
+        uint32_t index = 0;
+    };
+
+    struct Counters {
+        // Blocks whose IDs were computed
+        uint64_t computed = 0;
+        // Blocks whose IDs were served from the cache
+        uint64_t reused = 0;
+    };
+
+    // maxBlocks bounds the number of blocks whose transaction IDs are remembered
+    TransactionIdCache(size_t maxBlocks = 1000) : maxBlocks(maxBlocks) {}
+
+    // Compute the message ID of a transaction, as net::node would
+    static message_id_type computeMessageId(const signed_transaction& trx);
+
+    // Get the message IDs of all transactions in a block, in order, computing them if we haven't already
+    const std::vector<message_id_type>& blockTransactionIds(const signed_block& block);
+    // Check whether a message ID belongs to a transaction in one of the cached blocks
+    bool contains(const message_id_type& id) const { return locations.count(id) != 0; }
+    // Find the block and position of the transaction with the given message ID, if it's cached
+    std::optional<Location> find(const message_id_type& id) const;
+
+    const Counters& getCounters() const { return counters; }
+
+private:
+    const size_t maxBlocks;
+
+    // Block IDs in the order they were cached, for eviction
+    std::deque<block_id_type> blockOrder;
+    std::unordered_map<block_id_type, std::vector<message_id_type>> blockIds;
+    std::unordered_map<message_id_type, Location> locations;
+    Counters counters;
+
+    void evictOldest();
+};
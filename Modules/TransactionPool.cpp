@@ -0,0 +1,79 @@
+#include "TransactionPool.hpp"
+
+#include <fc/io/raw.hpp>
+
+bool TransactionPool::add(const signed_transaction& trx, const message_id_type& messageId, fc::time_point_sec now) {
+    if (trx.expiration <= now) {
+        ++counters.expired;
+        return false;
+    }
+
+    auto trxId = trx.id();
+    if (transactions.get<by_trx_id>().count(trxId)) {
+        ++counters.duplicates;
+        return false;
+    }
+    PooledTransaction pooled;
+    pooled.trxId = trxId;
+    pooled.messageId = messageId;
+    pooled.expiration = trx.expiration;
+    pooled.size = fc::raw::pack_size(trx);
+    pooled.trx = trx;
+
+    auto result = transactions.insert(std::move(pooled));
+    if (!result.second) {
+        ++counters.duplicates;
+        return false;
+    }
+    totalBytes += result.first->size;
+    ++counters.added;
+
+    // Make room by dropping the transactions closest to expiring
+    auto& byExpiration = transactions.get<by_expiration>();
+    bool keptNew = true;
+    while (totalBytes > maxBytes && !byExpiration.empty()) {
+        auto oldest = byExpiration.begin();
+        if (oldest->trxId == trxId)
+            keptNew = false;
+        totalBytes -= oldest->size;
+        byExpiration.erase(oldest);
+        ++counters.evicted;
+    }
+    return keptNew;
+}
+
+void TransactionPool::prune(fc::time_point_sec now) {
+    auto& byExpiration = transactions.get<by_expiration>();
+    while (!byExpiration.empty() && byExpiration.begin()->expiration <= now) {
+        totalBytes -= byExpiration.begin()->size;
+        byExpiration.erase(byExpiration.begin());
+        ++counters.expired;
+    }
+}
+
+void TransactionPool::removeIncluded(const signed_block& block) {
+    if (transactions.empty())
+        return;
+
+    auto& byTrxId = transactions.get<by_trx_id>();
+    for (const auto& trx : block.transactions) {
+        auto itr = byTrxId.find(trx.id());
+        if (itr != byTrxId.end()) {
+            totalBytes -= itr->size;
+            byTrxId.erase(itr);
+            ++counters.included;
+        }
+    }
+}
+
+bool TransactionPool::contains(const message_id_type& messageId) const {
+    return transactions.get<by_message_id>().count(messageId) != 0;
+}
+
+const TransactionPool::signed_transaction* TransactionPool::find(const message_id_type& messageId) const {
+    auto& byMessageId = transactions.get<by_message_id>();
+    auto itr = byMessageId.find(messageId);
+    if (itr == byMessageId.end())
+        return nullptr;
+    return &itr->trx;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <graphene/net/message.hpp>
+#include <graphene/protocol/block.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+// A memory-bounded pool of transactions we've received from the network but which are not yet in a block.
+//
+// Transactions are deduplicated by transaction ID and looked up by net::node message ID, both in constant time, and are
+// ordered by expiration so expired transactions can be pruned cheaply. When the pool exceeds its size limit, the
+// transactions closest to expiring are dropped first.
+class TransactionPool {
+public:
+    using signed_block = graphene::protocol::signed_block;
+    using signed_transaction = graphene::protocol::signed_transaction;
+    using transaction_id_type = graphene::protocol::transaction_id_type;
+    using message_id_type = graphene::net::message_hash_type;
+
+    struct Counters {
+        // Transactions added to the pool
+        uint64_t added = 0;
+        // Transactions rejected because the pool already had them
+        uint64_t duplicates = 0;
+        // Transactions rejected or removed because they expired
+        uint64_t expired = 0;
+        // Transactions removed to stay within the size limit
+        uint64_t evicted = 0;
+        // Transactions removed because they were included in a block
+        uint64_t included = 0;
+    };
+
+    // maxBytes bounds the total serialized size of the transactions in the pool
+    TransactionPool(size_t maxBytes = 32 * 1024 * 1024) : maxBytes(maxBytes) {}
+
+    // Add a transaction, with its message ID, to the pool. now is the current chain time, for checking expiration.
+    // Returns true if the transaction was added; false if it was a duplicate, expired, or did not fit.
+    bool add(const signed_transaction& trx, const message_id_type& messageId, fc::time_point_sec now);
+    // Remove transactions which have expired as of the provided time
+    void prune(fc::time_point_sec now);
+    // Remove the transactions included in a block
+    void removeIncluded(const signed_block& block);
+
+    bool contains(const message_id_type& messageId) const;
+    // Get the transaction with the given message ID, or null if it isn't pooled
+    const signed_transaction* find(const message_id_type& messageId) const;
+
+    size_t size() const { return transactions.size(); }
+    size_t bytes() const { return totalBytes; }
+    const Counters& getCounters() const { return counters; }
+
+private:
+    struct PooledTransaction {
+        message_id_type messageId;
+        transaction_id_type trxId;
+        fc::time_point_sec expiration;
+        size_t size = 0;
+        signed_transaction trx;
+    };
+
+    struct by_message_id;
+    struct by_trx_id;
+    struct by_expiration;
+    using PoolContainer = boost::multi_index_container<PooledTransaction,
+        boost::multi_index::indexed_by<
+            boost::multi_index::hashed_unique<boost::multi_index::tag<by_message_id>,
+                boost::multi_index::member<PooledTransaction, message_id_type, &PooledTransaction::messageId>,
+                std::hash<message_id_type>>,
+            boost::multi_index::hashed_unique<boost::multi_index::tag<by_trx_id>,
+                boost::multi_index::member<PooledTransaction, transaction_id_type, &PooledTransaction::trxId>,
+                std::hash<transaction_id_type>>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_expiration>,
+                boost::multi_index::member<PooledTransaction, fc::time_point_sec, &PooledTransaction::expiration>>>>;
+
+    const size_t maxBytes;
+    size_t totalBytes = 0;
+    PoolContainer transactions;
+    Counters counters;
+};
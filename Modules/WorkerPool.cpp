@@ -0,0 +1,18 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <thread>
+
+WorkerPool::WorkerPool(size_t threadCount, const std::string& name) {
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.emplace_back(std::make_unique<fc::thread>(name + " " + std::to_string(i)));
+}
+
+WorkerPool::~WorkerPool() {
+    for (auto& thread : threads)
+        thread->quit();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/future.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A fixed set of fc threads to run stateless work on, away from the main thread.
+// Tasks are handed out round-robin; results are returned as fc futures which can be waited on from any fc thread.
+class WorkerPool {
+    std::vector<std::unique_ptr<fc::thread>> threads;
+    std::atomic<size_t> nextThread{0};
+
+public:
+    // Create a pool of threadCount threads. If threadCount is zero, one thread per hardware thread is created.
+    WorkerPool(size_t threadCount = 0, const std::string& name = "Worker");
+    ~WorkerPool();
+
+    size_t size() const { return threads.size(); }
+
+    // Run a functor on the next worker thread, returning a future for its result
+    template<typename F>
+    auto run(F&& f, const char* description = "WorkerPool task") {
+        auto& thread = *threads[nextThread++ % threads.size()];
+        return thread.async(std::forward<F>(f), description);
+    }
+};
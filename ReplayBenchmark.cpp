@@ -0,0 +1,272 @@
+#include <Modules/ChainHandler.hpp>
+#include <Modules/ContractPlugin.hpp>
+#include <Modules/EvaluatorStats.hpp>
+
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/io/json.hpp>
+
+#include <boost/dll/runtime_symbol_info.hpp>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+
+// Replays a block log through the chain database, with the contract plugins loaded as the node loads them, and reports
+// how fast it went, so contract builds and node changes can be compared against identical input.
+constexpr static auto USAGE =
+R"(Usage: ReplayBenchmark --blocks <dir> --genesis <file> [options]
+  --blocks <dir>     Block database to replay, like <node config>/Chain/database/block_num_to_block
+  --genesis <file>   Genesis of the chain the blocks belong to
+  --data <dir>       Directory to build the replayed chain in; must not already hold a chain. Defaults to a temporary
+                     directory, which is removed afterwards.
+  --plugins <dir>    Directory to load contract plugins from; may be given more than once. Defaults to the directories
+                     ContractNode loads them from.
+  --skip <steps>     Comma-separated validation steps to skip, or "none" or "all". Defaults to the steps a replay of
+                     blocks already validated can skip: witness_signature, transaction_signatures,
+                     transaction_dupe_check, tapos_check, and authority_check.
+  --limit <count>    Replay at most this many blocks
+  --report <file>    Also write the report to a file
+)";
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using graphene::chain::database;
+
+const std::map<std::string, uint32_t> SKIP_STEPS = {
+    {"witness_signature", database::skip_witness_signature},
+    {"transaction_signatures", database::skip_transaction_signatures},
+    {"transaction_dupe_check", database::skip_transaction_dupe_check},
+    {"fork_db", database::skip_fork_db},
+    {"block_size_check", database::skip_block_size_check},
+    {"tapos_check", database::skip_tapos_check},
+    {"authority_check", database::skip_authority_check},
+    {"merkle_check", database::skip_merkle_check},
+    {"assert_evaluation", database::skip_assert_evaluation},
+    {"undo_history_check", database::skip_undo_history_check},
+    {"witness_schedule_check", database::skip_witness_schedule_check}
+};
+
+uint32_t parseSkip(const std::string& steps) {
+    uint32_t skip = database::skip_nothing;
+    if (steps == "none")
+        return skip;
+    if (steps == "all") {
+        for (const auto& step : SKIP_STEPS)
+            skip |= step.second;
+        return skip;
+    }
+
+    size_t start = 0;
+    while (start <= steps.size()) {
+        auto comma = std::min(steps.find(',', start), steps.size());
+        auto step = steps.substr(start, comma - start);
+        auto itr = SKIP_STEPS.find(step);
+        FC_ASSERT(itr != SKIP_STEPS.end(), "Unknown validation step: ${S}", ("S", step));
+        skip |= itr->second;
+        start = comma + 1;
+    }
+    return skip;
+}
+
+// Current resident set size, in kilobytes
+int64_t residentKilobytes() {
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int64_t peakResidentKilobytes() {
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+fc::mutable_variant_object percentiles(std::vector<int64_t>& samples) {
+    fc::mutable_variant_object result("count", samples.size());
+    if (samples.empty())
+        return result;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double quantile) { return samples[std::min<size_t>(quantile * samples.size(),
+                                                                             samples.size() - 1)]; };
+    return result("p50", at(.5))("p90", at(.9))("p99", at(.99))("max", samples.back());
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    fc::path blocksPath, genesisPath, dataPath, reportPath;
+    std::vector<ContractPlugin::Path> pluginPaths;
+    uint32_t skip = parseSkip("witness_signature,transaction_signatures,transaction_dupe_check,tapos_check,"
+                              "authority_check");
+    uint32_t limit = std::numeric_limits<uint32_t>::max();
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            FC_ASSERT(i + 1 < argc, "Missing value for ${A}", ("A", arg));
+            std::string value = argv[++i];
+            if (arg == "--blocks")
+                blocksPath = value;
+            else if (arg == "--genesis")
+                genesisPath = value;
+            else if (arg == "--data")
+                dataPath = value;
+            else if (arg == "--plugins")
+                pluginPaths.emplace_back(value);
+            else if (arg == "--skip")
+                skip = parseSkip(value);
+            else if (arg == "--limit")
+                limit = std::stoul(value);
+            else if (arg == "--report")
+                reportPath = value;
+            else
+                FC_THROW("Unknown option ${A}", ("A", arg));
+        }
+        FC_ASSERT(!blocksPath.string().empty() && !genesisPath.string().empty(), "--blocks and --genesis are required");
+        // The block database creates what it opens, so a mistyped path would otherwise replay nothing
+        FC_ASSERT(fc::is_directory(blocksPath), "Block database ${P} does not exist", ("P", blocksPath));
+    } catch (const fc::exception& e) {
+        std::cerr << e.to_string() << "\n\n" << USAGE;
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    bool temporaryData = dataPath.string().empty();
+    if (temporaryData)
+        dataPath = fc::temp_directory_path() / ("ReplayBenchmark-" + std::to_string(getpid()));
+    if (pluginPaths.empty())
+        pluginPaths = ContractPlugin::searchDirectories(boost::dll::program_location().parent_path(), "ContractNode");
+
+    fc::mutable_variant_object report;
+    try {
+        // Declared before the chain, so the contracts' code and their evaluators' observers outlive the chain
+        std::vector<ContractPlugin::LibraryPointer> libraries;
+        std::vector<std::unique_ptr<EvaluatorStats>> evaluatorStats;
+        ChainHandler handler;
+        handler.setConfigPath(dataPath);
+        handler.setJournalEnabled(false);
+        handler.setCheckpointsEnabled(false);
+        FC_ASSERT(!handler.hasChainState(), "${D} already holds a chain", ("D", dataPath));
+        fc::create_directories(dataPath);
+        if (fc::exists(dataPath / "genesis.json"))
+            fc::remove(dataPath / "genesis.json");
+        fc::copy(genesisPath, dataPath / "genesis.json");
+        handler.initialize();
+
+        fc::variants contracts;
+        for (const auto& directory : pluginPaths) {
+            for (const auto& file : ContractPlugin::listLibraries(directory)) {
+                try {
+                    auto library = ContractPlugin::load(file);
+                    if (library == nullptr)
+                        continue;
+                    auto exports = ContractPlugin::readExports(*library);
+                    if (exports.evaluatorObserver != nullptr) {
+                        evaluatorStats.emplace_back(std::make_unique<EvaluatorStats>(exports.name));
+                        *exports.evaluatorObserver = evaluatorStats.back().get();
+                    }
+                    if (handler.initializeContract(exports.name, exports.registerContract, exports.indexedFields,
+                                                   exports.tableNames, exports.tableReflections)) {
+                        ilog("Loaded contract ${N} from ${P}", ("N", exports.name)("P", file.string()));
+                        contracts.emplace_back(exports.name);
+                        libraries.emplace_back(std::move(library));
+                    } else {
+                        elog("Contract ${N} failed to initialize", ("N", exports.name));
+                    }
+                } catch (const fc::exception& e) {
+                    elog("Failed to load plugin ${P}: ${E}", ("P", file.string())("E", e.to_string()));
+                } catch (const std::exception& e) {
+                    elog("Failed to load plugin ${P}: ${E}", ("P", file.string())("E", e.what()));
+                }
+            }
+        }
+
+        handler.open();
+        auto& chain = handler.getChain();
+        graphene::chain::block_database blocks;
+        blocks.open(blocksPath);
+
+        auto residentBefore = residentKilobytes();
+        auto peakBefore = peakResidentKilobytes();
+        std::vector<int64_t> blockLatencies;
+        // For each operation in each block, the block's apply time divided evenly among its operations, by operation
+        // type. This attributes block overhead and other operations' time to each type, so it's only a share of block
+        // time; the contracts' evaluator statistics give the time each operation type actually took.
+        std::map<std::string, std::vector<int64_t>> blockTimeShares;
+        uint64_t transactions = 0, operations = 0;
+        std::vector<std::string> blockOperations;
+
+        auto firstNum = chain.head_block_num() + 1;
+        ilog("Replaying blocks from #${N}", ("N", firstNum));
+        auto start = Clock::now();
+        for (auto num = firstNum; num - firstNum < limit; ++num) {
+            auto block = blocks.fetch_by_number(num);
+            if (!block.valid())
+                break;
+
+            blockOperations.clear();
+            for (const auto& transaction : block->transactions)
+                for (const auto& operation : transaction.operations)
+                    blockOperations.emplace_back(EvaluatorStats::operationName(operation.which()));
+
+            auto applyStart = Clock::now();
+            chain.push_block(*block, skip);
+            auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - applyStart).count();
+
+            blockLatencies.push_back(latency);
+            transactions += block->transactions.size();
+            operations += blockOperations.size();
+            for (const auto& name : blockOperations)
+                blockTimeShares[name].push_back(latency / int64_t(blockOperations.size()));
+            if (blockLatencies.size() % 10000 == 0)
+                ilog("Replayed ${N} blocks", ("N", blockLatencies.size()));
+        }
+        auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        blocks.close();
+        FC_ASSERT(!blockLatencies.empty(), "No blocks replayed: ${P} has no block #${N}",
+                  ("P", blocksPath)("N", firstNum));
+
+        fc::mutable_variant_object shareReport;
+        for (auto& [name, shares] : blockTimeShares)
+            shareReport(name, percentiles(shares));
+        fc::variants evaluatorReport;
+        for (const auto& stats : evaluatorStats)
+            evaluatorReport.emplace_back(stats->report());
+        report("contracts", contracts)
+              ("skip", skip)
+              ("firstBlock", firstNum)
+              ("blocks", blockLatencies.size())
+              ("transactions", transactions)
+              ("operations", operations)
+              ("seconds", seconds)
+              ("blocksPerSecond", seconds > 0? blockLatencies.size() / seconds : 0)
+              ("operationsPerSecond", seconds > 0? operations / seconds : 0)
+              ("blockMicroseconds", percentiles(blockLatencies))
+              ("blockTimeShareMicroseconds", shareReport)
+              ("contractEvaluators", evaluatorReport)
+              ("residentKilobytesGrowth", residentKilobytes() - residentBefore)
+              ("peakResidentKilobytesGrowth", peakResidentKilobytes() - peakBefore);
+    } catch (const fc::exception& e) {
+        elog("Replay failed: ${E}", ("E", e.to_detail_string()));
+        if (temporaryData)
+            fc::remove_all(dataPath);
+        return 1;
+    }
+    if (temporaryData)
+        fc::remove_all(dataPath);
+
+    auto json = fc::json::to_pretty_string(report);
+    std::cout << json << std::endl;
+    if (!reportPath.string().empty())
+        std::ofstream(reportPath.string()) << json << std::endl;
+    return 0;
+}
@@ -1,6 +1,6 @@
 #include <Modules/ContractNode.hpp>
 
-int main() {
+int main(int argc, char** argv) {
     // Just push the power button; it runs itself.
-    return Node::ContractNode().run();
+    return Node::ContractNode(argc, argv).run();
 }